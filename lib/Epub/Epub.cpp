@@ -3,33 +3,115 @@
 #include <HardwareSerial.h>
 #include <JpegToBmpConverter.h>
 #include <SD.h>
-#include <ZipFile.h>
+#include <Serialization.h>
 
+#include <fstream>
+#include <functional>
 #include <map>
 
+#include "Epub/FingerprintMap.h"
 #include "Epub/FsHelpers.h"
 #include "Epub/parsers/ContainerParser.h"
 #include "Epub/parsers/ContentOpfParser.h"
 #include "Epub/parsers/TocNcxParser.h"
 
-bool Epub::findContentOpfFile(std::string* contentOpfFile) const {
-  const auto containerPath = "META-INF/container.xml";
-  size_t containerSize;
+namespace {
+constexpr uint8_t BOOK_FILE_VERSION = 3;
+
+// book.bin holds the book level strings, then fixed size spine and toc records, then a string pool referenced by
+// offset from the records. Records are read on demand so the spine and toc never have to be held in memory. Stored
+// raw rather than through LzssOutputBuffer, which would turn each of those reads into decoding the whole file.
+struct SpineRecord {
+  uint32_t hrefOffset;
+  uint32_t hrefLength;
+  uint32_t cumulativeSize;
+  int32_t tocIndex;
+};
+static_assert(sizeof(SpineRecord) == 16, "SpineRecord must be tightly packed");
+
+struct TocRecord {
+  uint32_t titleOffset;
+  uint32_t hrefOffset;
+  uint32_t anchorOffset;
+  uint16_t titleLength;
+  uint16_t hrefLength;
+  uint16_t anchorLength;
+  uint8_t level;
+  uint8_t reserved;
+  int32_t spineIndex;
+};
+static_assert(sizeof(TocRecord) == 24, "TocRecord must be tightly packed");
+
+uint16_t poolLength(const std::string& s) { return s.size() < UINT16_MAX ? s.size() : UINT16_MAX; }
+
+// Holds the mutex for the rest of the scope
+class MutexLock {
+  SemaphoreHandle_t mutex;
+
+ public:
+  explicit MutexLock(SemaphoreHandle_t mutex) : mutex(mutex) { xSemaphoreTake(mutex, portMAX_DELAY); }
+  ~MutexLock() { xSemaphoreGive(mutex); }
+  MutexLock(const MutexLock&) = delete;
+  MutexLock& operator=(const MutexLock&) = delete;
+};
+}  // namespace
+
+Epub::~Epub() {
+  if (bookDataMutex) {
+    vSemaphoreDelete(bookDataMutex);
+  }
+}
+
+std::string normalisePath(const std::string& path) {
+  std::vector<std::string> components;
+  std::string component;
+
+  for (const auto c : path) {
+    if (c == '/') {
+      if (!component.empty()) {
+        if (component == "..") {
+          if (!components.empty()) {
+            components.pop_back();
+          }
+        } else {
+          components.push_back(component);
+        }
+        component.clear();
+      }
+    } else {
+      component += c;
+    }
+  }
 
-  // Get file size without loading it all into heap
-  if (!getItemSize(containerPath, &containerSize)) {
-    Serial.printf("[%lu] [EBP] Could not find or size META-INF/container.xml\n", millis());
+  if (!component.empty()) {
+    components.push_back(component);
+  }
+
+  std::string result;
+  for (const auto& c : components) {
+    if (!result.empty()) {
+      result += "/";
+    }
+    result += c;
+  }
+
+  return result;
+}
+
+bool Epub::findContentOpfFile(std::string* contentOpfFile) const {
+  const auto containerReader = openItemContentsReader("META-INF/container.xml", 512);
+  if (!containerReader) {
+    Serial.printf("[%lu] [EBP] Could not find META-INF/container.xml\n", millis());
     return false;
   }
 
-  ContainerParser containerParser(containerSize);
+  ContainerParser containerParser;
 
   if (!containerParser.setup()) {
     return false;
   }
 
-  // Stream read (reusing your existing stream logic)
-  if (!readItemContentsToStream(containerPath, containerParser, 512)) {
+  if (!containerParser.parse(*containerReader)) {
     Serial.printf("[%lu] [EBP] Could not read META-INF/container.xml\n", millis());
     return false;
   }
@@ -47,39 +129,37 @@ bool Epub::findContentOpfFile(std::string* contentOpfFile) const {
 bool Epub::parseContentOpf(const std::string& contentOpfFilePath) {
   Serial.printf("[%lu] [EBP] Parsing content.opf: %s\n", millis(), contentOpfFilePath.c_str());
 
-  size_t contentOpfSize;
-  if (!getItemSize(contentOpfFilePath, &contentOpfSize)) {
-    Serial.printf("[%lu] [EBP] Could not get size of content.opf\n", millis());
+  const auto contentOpfReader = openItemContentsReader(contentOpfFilePath, 1024);
+  if (!contentOpfReader) {
+    Serial.printf("[%lu] [EBP] Could not open content.opf\n", millis());
     return false;
   }
 
-  ContentOpfParser opfParser(getBasePath(), contentOpfSize);
+  ContentOpfParser opfParser(getBasePath());
 
   if (!opfParser.setup()) {
     Serial.printf("[%lu] [EBP] Could not setup content.opf parser\n", millis());
     return false;
   }
 
-  if (!readItemContentsToStream(contentOpfFilePath, opfParser, 1024)) {
+  if (!opfParser.parse(*contentOpfReader)) {
     Serial.printf("[%lu] [EBP] Could not read content.opf\n", millis());
     return false;
   }
 
   // Grab data from opfParser into epub
   title = opfParser.title;
-  if (!opfParser.coverItemId.empty() && opfParser.items.count(opfParser.coverItemId) > 0) {
-    coverImageItem = opfParser.items.at(opfParser.coverItemId);
+  if (!opfParser.coverItemId.empty()) {
+    coverImageItem = opfParser.getItemHref(opfParser.coverItemId);
   }
 
   if (!opfParser.tocNcxPath.empty()) {
     tocNcxItem = opfParser.tocNcxPath;
   }
 
-  for (auto& spineRef : opfParser.spineRefs) {
-    if (opfParser.items.count(spineRef)) {
-      spine.emplace_back(spineRef, opfParser.items.at(spineRef));
-    }
-  }
+  opfParser.resolveSpine(spine);
+  // The manifest is only needed to resolve the spine, free it before the toc is parsed
+  opfParser.release();
 
   Serial.printf("[%lu] [EBP] Successfully parsed content.opf\n", millis());
   return true;
@@ -94,42 +174,23 @@ bool Epub::parseTocNcxFile() {
 
   Serial.printf("[%lu] [EBP] Parsing toc ncx file: %s\n", millis(), tocNcxItem.c_str());
 
-  const auto tmpNcxPath = getCachePath() + "/toc.ncx";
-  File tempNcxFile = SD.open(tmpNcxPath.c_str(), FILE_WRITE);
-  readItemContentsToStream(tocNcxItem, tempNcxFile, 1024);
-  tempNcxFile.close();
-  tempNcxFile = SD.open(tmpNcxPath.c_str(), FILE_READ);
-  const auto ncxSize = tempNcxFile.size();
+  const auto ncxReader = openItemContentsReader(tocNcxItem, 1024);
+  if (!ncxReader) {
+    return false;
+  }
 
-  TocNcxParser ncxParser(contentBasePath, ncxSize);
+  TocNcxParser ncxParser(contentBasePath);
 
   if (!ncxParser.setup()) {
     Serial.printf("[%lu] [EBP] Could not setup toc ncx parser\n", millis());
     return false;
   }
 
-  const auto ncxBuffer = static_cast<uint8_t*>(malloc(1024));
-  if (!ncxBuffer) {
-    Serial.printf("[%lu] [EBP] Could not allocate memory for toc ncx parser\n", millis());
+  if (!ncxParser.parse(*ncxReader)) {
+    Serial.printf("[%lu] [EBP] Could not process all toc ncx data\n", millis());
     return false;
   }
 
-  while (tempNcxFile.available()) {
-    const auto readSize = tempNcxFile.read(ncxBuffer, 1024);
-    const auto processedSize = ncxParser.write(ncxBuffer, readSize);
-
-    if (processedSize != readSize) {
-      Serial.printf("[%lu] [EBP] Could not process all toc ncx data\n", millis());
-      free(ncxBuffer);
-      tempNcxFile.close();
-      return false;
-    }
-  }
-
-  free(ncxBuffer);
-  tempNcxFile.close();
-  SD.remove(tmpNcxPath.c_str());
-
   this->toc = std::move(ncxParser.toc);
 
   Serial.printf("[%lu] [EBP] Parsed %d TOC items\n", millis(), this->toc.size());
@@ -137,9 +198,28 @@ bool Epub::parseTocNcxFile() {
 }
 
 // load in the meta data for the epub file
-bool Epub::load() {
+bool Epub::load(const bool buildIfMissing) {
   Serial.printf("[%lu] [EBP] Loading ePub: %s\n", millis(), filepath.c_str());
 
+  if (!resolveCachePath()) {
+    Serial.printf("[%lu] [EBP] Could not fingerprint %s\n", millis(), filepath.c_str());
+    return false;
+  }
+
+  if (loadBookMetadata()) {
+    Serial.printf("[%lu] [EBP] Loaded ePub from cache: %s\n", millis(), filepath.c_str());
+    recordCacheUse(cachePath, false);
+    return true;
+  }
+
+  if (!buildIfMissing) {
+    Serial.printf("[%lu] [EBP] No cached metadata for %s\n", millis(), filepath.c_str());
+    return false;
+  }
+
+  // The zip index and book metadata are written into the cache directory
+  setupCacheDir();
+
   std::string contentOpfFilePath;
   if (!findContentOpfFile(&contentOpfFilePath)) {
     Serial.printf("[%lu] [EBP] Could not find content.opf in zip\n", millis());
@@ -161,7 +241,18 @@ bool Epub::load() {
   }
 
   initializeSpineItemSizes();
+  initializeSpineTocIndex();
+  if (!saveBookMetadata()) {
+    return false;
+  }
+  releaseBookMetadataBuildData();
+
+  if (!loadBookMetadata()) {
+    Serial.printf("[%lu] [EBP] Could not read back book metadata\n", millis());
+    return false;
+  }
   Serial.printf("[%lu] [EBP] Loaded ePub: %s\n", millis(), filepath.c_str());
+  recordCacheUse(cachePath, true);
 
   return true;
 }
@@ -169,14 +260,23 @@ bool Epub::load() {
 void Epub::initializeSpineItemSizes() {
   Serial.printf("[%lu] [EBP] Calculating book size\n", millis());
 
-  const size_t spineItemsCount = getSpineItemsCount();
-  size_t cumSpineItemSize = 0;
-  const ZipFile zip("/sd" + filepath);
+  const size_t spineItemsCount = spine.size();
+  std::vector<std::string> spinePaths;
+  spinePaths.reserve(spineItemsCount);
+  for (const auto& spineItem : spine) {
+    spinePaths.push_back(normalisePath(spineItem.second));
+  }
 
-  for (size_t i = 0; i < spineItemsCount; i++) {
-    std::string spineItem = getSpineItem(i);
-    size_t s = 0;
-    getItemSize(zip, spineItem, &s);
+  // Sizes for the whole spine come from a single pass over the zip index
+  std::vector<size_t> spineItemSizes;
+  if (!getZip().getInflatedFileSizes(spinePaths, spineItemSizes)) {
+    Serial.printf("[%lu] [EBP] Could not find the size of all spine items\n", millis());
+  }
+
+  size_t cumSpineItemSize = 0;
+  cumulativeSpineItemSize.clear();
+  cumulativeSpineItemSize.reserve(spineItemsCount);
+  for (const auto s : spineItemSizes) {
     cumSpineItemSize += s;
     cumulativeSpineItemSize.emplace_back(cumSpineItemSize);
   }
@@ -184,7 +284,245 @@ void Epub::initializeSpineItemSizes() {
   Serial.printf("[%lu] [EBP] Book size: %lu\n", millis(), cumSpineItemSize);
 }
 
+std::string Epub::getBookMetadataPath() const { return cachePath + "/book.bin"; }
+
+bool Epub::saveBookMetadata() const {
+  size_t archiveSize;
+  if (!getZip().getArchiveSize(&archiveSize)) {
+    return false;
+  }
+
+  std::ofstream outputFile("/sd" + getBookMetadataPath());
+  serialization::writePod(outputFile, BOOK_FILE_VERSION);
+  serialization::writePod(outputFile, static_cast<uint32_t>(archiveSize));
+  serialization::writeString(outputFile, title);
+  serialization::writeString(outputFile, coverImageItem);
+  serialization::writeString(outputFile, tocNcxItem);
+  serialization::writeString(outputFile, contentBasePath);
+  serialization::writePod(outputFile, static_cast<uint32_t>(spine.size()));
+  serialization::writePod(outputFile, static_cast<uint32_t>(toc.size()));
+
+  // Records first, with string offsets assigned in the order the strings are written to the pool below
+  uint32_t poolOffset = 0;
+  for (size_t i = 0; i < spine.size(); i++) {
+    SpineRecord record;
+    record.hrefOffset = poolOffset;
+    record.hrefLength = spine[i].second.size();
+    record.cumulativeSize = i < cumulativeSpineItemSize.size() ? cumulativeSpineItemSize[i] : 0;
+    record.tocIndex = spineToTocIndex[i];
+    poolOffset += record.hrefLength;
+    serialization::writePod(outputFile, record);
+  }
+
+  for (size_t i = 0; i < toc.size(); i++) {
+    TocRecord record = {};
+    record.titleLength = poolLength(toc[i].title);
+    record.hrefLength = poolLength(toc[i].href);
+    record.anchorLength = poolLength(toc[i].anchor);
+    record.titleOffset = poolOffset;
+    record.hrefOffset = record.titleOffset + record.titleLength;
+    record.anchorOffset = record.hrefOffset + record.hrefLength;
+    record.level = toc[i].level;
+    record.spineIndex = tocToSpineIndex[i];
+    poolOffset = record.anchorOffset + record.anchorLength;
+    serialization::writePod(outputFile, record);
+  }
+
+  for (const auto& spineItem : spine) {
+    outputFile.write(spineItem.second.data(), spineItem.second.size());
+  }
+  for (const auto& tocEntry : toc) {
+    outputFile.write(tocEntry.title.data(), poolLength(tocEntry.title));
+    outputFile.write(tocEntry.href.data(), poolLength(tocEntry.href));
+    outputFile.write(tocEntry.anchor.data(), poolLength(tocEntry.anchor));
+  }
+
+  const bool success = outputFile.good();
+  outputFile.close();
+  if (!success) {
+    Serial.printf("[%lu] [EBP] Failed to write book metadata\n", millis());
+    SD.remove(getBookMetadataPath().c_str());
+  }
+  return success;
+}
+
+bool Epub::loadBookMetadata() {
+  if (!SD.exists(getBookMetadataPath().c_str())) {
+    return false;
+  }
+
+  size_t archiveSize;
+  if (!getZip().getArchiveSize(&archiveSize)) {
+    return false;
+  }
+
+  std::ifstream bookFile("/sd" + getBookMetadataPath());
+
+  uint8_t version;
+  uint32_t fileArchiveSize;
+  serialization::readPod(bookFile, version);
+  serialization::readPod(bookFile, fileArchiveSize);
+  if (!bookFile || version != BOOK_FILE_VERSION || fileArchiveSize != archiveSize) {
+    Serial.printf("[%lu] [EBP] Book metadata is stale, reparsing\n", millis());
+    return false;
+  }
+
+  uint32_t fileSpineCount, fileTocCount;
+  serialization::readString(bookFile, title);
+  serialization::readString(bookFile, coverImageItem);
+  serialization::readString(bookFile, tocNcxItem);
+  serialization::readString(bookFile, contentBasePath);
+  serialization::readPod(bookFile, fileSpineCount);
+  serialization::readPod(bookFile, fileTocCount);
+  if (!bookFile) {
+    Serial.printf("[%lu] [EBP] Failed to read book metadata\n", millis());
+    return false;
+  }
+
+  spineCount = fileSpineCount;
+  tocCount = fileTocCount;
+  spineTableOffset = bookFile.tellg();
+  tocTableOffset = spineTableOffset + spineCount * sizeof(SpineRecord);
+  stringPoolOffset = tocTableOffset + tocCount * sizeof(TocRecord);
+  spineWindow.clear();
+  tocWindow.clear();
+
+  Serial.printf("[%lu] [EBP] Read book metadata: %d spine items, %d TOC items\n", millis(), spineCount, tocCount);
+  return true;
+}
+
+void Epub::releaseBookMetadataBuildData() {
+  // Everything here now lives in book.bin
+  std::vector<std::pair<std::string, std::string>>().swap(spine);
+  std::vector<size_t>().swap(cumulativeSpineItemSize);
+  std::vector<EpubTocEntry>().swap(toc);
+  std::vector<int>().swap(spineToTocIndex);
+  std::vector<int>().swap(tocToSpineIndex);
+}
+
+std::string Epub::readBookString(std::istream& bookFile, const uint32_t offset, const uint32_t length) const {
+  std::string s(length, '\0');
+  bookFile.clear();
+  bookFile.seekg(stringPoolOffset + offset);
+  bookFile.read(&s[0], length);
+  return s;
+}
+
+const Epub::CachedSpineItem* Epub::getCachedSpineItem(const int spineIndex) const {
+  if (const auto cached = spineWindow.find(spineIndex)) {
+    return cached;
+  }
+
+  SpineRecord record;
+  std::ifstream bookFile("/sd" + getBookMetadataPath());
+  bookFile.seekg(spineTableOffset + spineIndex * static_cast<std::streamoff>(sizeof(SpineRecord)));
+  serialization::readPod(bookFile, record);
+  if (!bookFile) {
+    Serial.printf("[%lu] [EBP] Failed to read spine record %d\n", millis(), spineIndex);
+    return nullptr;
+  }
+
+  auto& item = spineWindow.insert(spineIndex);
+  item.href = readBookString(bookFile, record.hrefOffset, record.hrefLength);
+  item.cumulativeSize = record.cumulativeSize;
+  item.tocIndex = record.tocIndex;
+  return &item;
+}
+
+const Epub::CachedTocItem* Epub::getCachedTocItem(const int tocIndex) const {
+  if (const auto cached = tocWindow.find(tocIndex)) {
+    return cached;
+  }
+
+  TocRecord record;
+  std::ifstream bookFile("/sd" + getBookMetadataPath());
+  bookFile.seekg(tocTableOffset + tocIndex * static_cast<std::streamoff>(sizeof(TocRecord)));
+  serialization::readPod(bookFile, record);
+  if (!bookFile) {
+    Serial.printf("[%lu] [EBP] Failed to read toc record %d\n", millis(), tocIndex);
+    return nullptr;
+  }
+
+  auto& item = tocWindow.insert(tocIndex);
+  item.entry.title = readBookString(bookFile, record.titleOffset, record.titleLength);
+  item.entry.href = readBookString(bookFile, record.hrefOffset, record.hrefLength);
+  item.entry.anchor = readBookString(bookFile, record.anchorOffset, record.anchorLength);
+  item.entry.level = record.level;
+  item.spineIndex = record.spineIndex;
+  return &item;
+}
+
+void Epub::initializeSpineTocIndex() {
+  std::unordered_map<std::string, int> spineIndexByPath;
+  spineIndexByPath.reserve(spine.size());
+  for (int i = 0; i < spine.size(); i++) {
+    spineIndexByPath.emplace(normalisePath(spine[i].second), i);
+  }
+
+  spineToTocIndex.assign(spine.size(), -1);
+  tocToSpineIndex.assign(toc.size(), -1);
+  for (int i = 0; i < toc.size(); i++) {
+    // TOC hrefs can carry a fragment or resolve through different relative segments, compare normalised paths
+    const auto& href = toc[i].href;
+    const auto spineIndex = spineIndexByPath.find(normalisePath(href.substr(0, href.find('#'))));
+    if (spineIndex == spineIndexByPath.end()) {
+      continue;
+    }
+
+    tocToSpineIndex[i] = spineIndex->second;
+    if (spineToTocIndex[spineIndex->second] == -1) {
+      spineToTocIndex[spineIndex->second] = i;
+    }
+  }
+}
+
+bool Epub::resolveCachePath() {
+  // Keyed on the archive's contents rather than its path, so moving a book keeps its cache and replacing one never
+  // picks up the old cache
+  ZipFingerprint fingerprint;
+  FingerprintMap fingerprints(cacheDir + "/fingerprints.bin");
+  if (!fingerprints.resolve(filepath, getZip(), &fingerprint)) {
+    return false;
+  }
+
+  char key[32];
+  snprintf(key, sizeof(key), "/epub_%08x%08x%08x", fingerprint.archiveSize, fingerprint.centralDirectoryCrc,
+           fingerprint.opfCrc);
+  cachePath = cacheDir + key;
+  zip->setIndexPath(getZipIndexPath());
+  migrateLegacyCache();
+  return true;
+}
+
+void Epub::migrateLegacyCache() const {
+  // Caches used to be keyed on a hash of the book's path, everything in them is rebuilt except the reading position
+  const std::string legacyPath = cacheDir + "/epub_" + std::to_string(std::hash<std::string>{}(filepath));
+  if (legacyPath == cachePath || !SD.exists(legacyPath.c_str())) {
+    return;
+  }
+
+  Serial.printf("[%lu] [EBP] Moving reading position from legacy cache %s\n", millis(), legacyPath.c_str());
+  setupCacheDir();
+  for (const char* name : {"/progress.bin", "/cover.bmp"}) {
+    const std::string from = legacyPath + name;
+    const std::string to = cachePath + name;
+    if (SD.exists(from.c_str()) && !SD.exists(to.c_str()) && !SD.rename(from.c_str(), to.c_str())) {
+      Serial.printf("[%lu] [EBP] Failed to move %s\n", millis(), from.c_str());
+    }
+  }
+
+  if (!FsHelpers::removeDir(legacyPath.c_str())) {
+    Serial.printf("[%lu] [EBP] Failed to remove legacy cache %s\n", millis(), legacyPath.c_str());
+  }
+  cacheIndex.forget(legacyPath);
+  cacheIndex.save();
+}
+
 bool Epub::clearCache() const {
+  if (cachePath.empty()) {
+    return false;
+  }
+
   if (!SD.exists(cachePath.c_str())) {
     Serial.printf("[%lu] [EPB] Cache does not exist, no action needed\n", millis());
     return true;
@@ -194,6 +532,8 @@ bool Epub::clearCache() const {
     Serial.printf("[%lu] [EPB] Failed to clear cache\n", millis());
     return false;
   }
+  cacheIndex.forget(cachePath);
+  cacheIndex.save();
 
   Serial.printf("[%lu] [EPB] Cache cleared successfully\n", millis());
   return true;
@@ -215,6 +555,37 @@ void Epub::setupCacheDir() const {
 
 const std::string& Epub::getCachePath() const { return cachePath; }
 
+void Epub::recordCacheUse(const std::string& path, const bool grown) const {
+  // The book's own directory is touched after any variant below it, so it is never older than what it holds
+  if (path != cachePath) {
+    cacheIndex.touch(path);
+  }
+  cacheIndex.touch(cachePath);
+  if (grown) {
+    // Section builds also add inflate checkpoints to the book's own directory
+    cacheIndex.measure(cachePath);
+    if (path != cachePath) {
+      cacheIndex.measure(path);
+    }
+    if (cacheBudget > 0) {
+      cacheIndex.enforceBudget(cacheBudget, path);
+    }
+  }
+  cacheIndex.save();
+}
+
+std::string Epub::getZipIndexPath() const { return "/sd" + cachePath + "/zip_index.bin"; }
+
+const ZipFile& Epub::getZip() const {
+  // Opened lazily and then held for the lifetime of the book, so the archive handle, index and looked up
+  // entries are shared by every read
+  if (!zip) {
+    // No index until load() has worked out the cache path
+    zip.reset(new ZipFile("/sd" + filepath, cachePath.empty() ? "" : getZipIndexPath()));
+  }
+  return *zip;
+}
+
 const std::string& Epub::getPath() const { return filepath; }
 
 const std::string& Epub::getTitle() const { return title; }
@@ -235,16 +606,14 @@ bool Epub::generateCoverBmp() const {
   if (coverImageItem.substr(coverImageItem.length() - 4) == ".jpg" ||
       coverImageItem.substr(coverImageItem.length() - 5) == ".jpeg") {
     Serial.printf("[%lu] [EBP] Generating BMP from JPG cover image\n", millis());
-    File coverJpg = SD.open((getCachePath() + "/.cover.jpg").c_str(), FILE_WRITE, true);
-    readItemContentsToStream(coverImageItem, coverJpg, 1024);
-    coverJpg.close();
+    const auto coverJpg = openItemContentsReader(coverImageItem, 1024);
+    if (!coverJpg) {
+      return false;
+    }
 
-    coverJpg = SD.open((getCachePath() + "/.cover.jpg").c_str(), FILE_READ);
     File coverBmp = SD.open(getCoverBmpPath().c_str(), FILE_WRITE, true);
-    const bool success = JpegToBmpConverter::jpegFileToBmpStream(coverJpg, coverBmp);
-    coverJpg.close();
+    const bool success = JpegToBmpConverter::jpegToBmpStream(*coverJpg, coverBmp);
     coverBmp.close();
-    SD.remove((getCachePath() + "/.cover.jpg").c_str());
 
     if (!success) {
       Serial.printf("[%lu] [EBP] Failed to generate BMP from JPG cover image\n", millis());
@@ -259,47 +628,10 @@ bool Epub::generateCoverBmp() const {
   return false;
 }
 
-std::string normalisePath(const std::string& path) {
-  std::vector<std::string> components;
-  std::string component;
-
-  for (const auto c : path) {
-    if (c == '/') {
-      if (!component.empty()) {
-        if (component == "..") {
-          if (!components.empty()) {
-            components.pop_back();
-          }
-        } else {
-          components.push_back(component);
-        }
-        component.clear();
-      }
-    } else {
-      component += c;
-    }
-  }
-
-  if (!component.empty()) {
-    components.push_back(component);
-  }
-
-  std::string result;
-  for (const auto& c : components) {
-    if (!result.empty()) {
-      result += "/";
-    }
-    result += c;
-  }
-
-  return result;
-}
-
 uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size, bool trailingNullByte) const {
-  const ZipFile zip("/sd" + filepath);
   const std::string path = normalisePath(itemHref);
 
-  const auto content = zip.readFileToMemory(path.c_str(), size, trailingNullByte);
+  const auto content = getZip().readFileToMemory(path.c_str(), size, trailingNullByte);
   if (!content) {
     Serial.printf("[%lu] [EBP] Failed to read item %s\n", millis(), path.c_str());
     return nullptr;
@@ -309,102 +641,109 @@ uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size
 }
 
 bool Epub::readItemContentsToStream(const std::string& itemHref, Print& out, const size_t chunkSize) const {
-  const ZipFile zip("/sd" + filepath);
   const std::string path = normalisePath(itemHref);
 
-  return zip.readFileToStream(path.c_str(), out, chunkSize);
+  return getZip().readFileToStream(path.c_str(), out, chunkSize);
 }
 
-bool Epub::getItemSize(const std::string& itemHref, size_t* size) const {
-  const ZipFile zip("/sd" + filepath);
-  return getItemSize(zip, itemHref, size);
+std::unique_ptr<ZipEntryReader> Epub::openItemContentsReader(const std::string& itemHref,
+                                                             const size_t chunkSize) const {
+  const std::string path = normalisePath(itemHref);
+  auto reader = getZip().openFileReader(path.c_str(), chunkSize);
+  if (!reader) {
+    Serial.printf("[%lu] [EBP] Failed to open item: %s\n", millis(), itemHref.c_str());
+  }
+
+  return reader;
 }
 
-bool Epub::getItemSize(const ZipFile& zip, const std::string& itemHref, size_t* size) {
+bool Epub::getItemSize(const std::string& itemHref, size_t* size) const {
   const std::string path = normalisePath(itemHref);
-  return zip.getInflatedFileSize(path.c_str(), size);
+  return getZip().getInflatedFileSize(path.c_str(), size);
 }
 
-int Epub::getSpineItemsCount() const { return spine.size(); }
+int Epub::getSpineItemsCount() const { return spineCount; }
 
 size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const {
-  if (spineIndex < 0 || spineIndex >= static_cast<int>(cumulativeSpineItemSize.size())) {
+  if (spineIndex < 0 || spineIndex >= spineCount) {
     Serial.printf("[%lu] [EBP] getCumulativeSpineItemSize index:%d is out of range\n", millis(), spineIndex);
     return 0;
   }
-  return cumulativeSpineItemSize.at(spineIndex);
+
+  const MutexLock lock(bookDataMutex);
+  const auto item = getCachedSpineItem(spineIndex);
+  return item ? item->cumulativeSize : 0;
 }
 
-std::string& Epub::getSpineItem(const int spineIndex) {
-  static std::string emptyString;
-  if (spine.empty()) {
+std::string Epub::getSpineItem(const int spineIndex) const {
+  if (spineCount == 0) {
     Serial.printf("[%lu] [EBP] getSpineItem called but spine is empty\n", millis());
-    return emptyString;
+    return "";
   }
-  if (spineIndex < 0 || spineIndex >= static_cast<int>(spine.size())) {
+
+  const MutexLock lock(bookDataMutex);
+  const CachedSpineItem* item;
+  if (spineIndex < 0 || spineIndex >= spineCount) {
     Serial.printf("[%lu] [EBP] getSpineItem index:%d is out of range\n", millis(), spineIndex);
-    return spine.at(0).second;
+    item = getCachedSpineItem(0);
+  } else {
+    item = getCachedSpineItem(spineIndex);
   }
 
-  return spine.at(spineIndex).second;
+  return item ? item->href : "";
 }
 
-EpubTocEntry& Epub::getTocItem(const int tocTndex) {
-  static EpubTocEntry emptyEntry = {};
-  if (toc.empty()) {
+EpubTocEntry Epub::getTocItem(const int tocTndex) const {
+  if (tocCount == 0) {
     Serial.printf("[%lu] [EBP] getTocItem called but toc is empty\n", millis());
-    return emptyEntry;
+    return {};
   }
-  if (tocTndex < 0 || tocTndex >= static_cast<int>(toc.size())) {
+
+  const MutexLock lock(bookDataMutex);
+  const CachedTocItem* item;
+  if (tocTndex < 0 || tocTndex >= tocCount) {
     Serial.printf("[%lu] [EBP] getTocItem index:%d is out of range\n", millis(), tocTndex);
-    return toc.at(0);
+    item = getCachedTocItem(0);
+  } else {
+    item = getCachedTocItem(tocTndex);
   }
 
-  return toc.at(tocTndex);
+  return item ? item->entry : EpubTocEntry{};
 }
 
-int Epub::getTocItemsCount() const { return toc.size(); }
+int Epub::getTocItemsCount() const { return tocCount; }
 
 // work out the section index for a toc index
 int Epub::getSpineIndexForTocIndex(const int tocIndex) const {
-  if (tocIndex < 0 || tocIndex >= toc.size()) {
+  if (tocIndex < 0 || tocIndex >= tocCount) {
     Serial.printf("[%lu] [EBP] getSpineIndexForTocIndex: tocIndex %d out of range\n", millis(), tocIndex);
     return 0;
   }
 
-  // the toc entry should have an href that matches the spine item
-  // so we can find the spine index by looking for the href
-  for (int i = 0; i < spine.size(); i++) {
-    if (spine[i].second == toc[tocIndex].href) {
-      return i;
-    }
+  const MutexLock lock(bookDataMutex);
+  const auto item = getCachedTocItem(tocIndex);
+  if (!item || item->spineIndex == -1) {
+    Serial.printf("[%lu] [EBP] Section not found\n", millis());
+    // not found - default to the start of the book
+    return 0;
   }
 
-  Serial.printf("[%lu] [EBP] Section not found\n", millis());
-  // not found - default to the start of the book
-  return 0;
+  return item->spineIndex;
 }
 
 int Epub::getTocIndexForSpineIndex(const int spineIndex) const {
-  if (spineIndex < 0 || spineIndex >= spine.size()) {
+  if (spineIndex < 0 || spineIndex >= spineCount) {
     Serial.printf("[%lu] [EBP] getTocIndexForSpineIndex: spineIndex %d out of range\n", millis(), spineIndex);
     return -1;
   }
 
-  // the toc entry should have an href that matches the spine item
-  // so we can find the toc index by looking for the href
-  for (int i = 0; i < toc.size(); i++) {
-    if (toc[i].href == spine[spineIndex].second) {
-      return i;
-    }
-  }
-
-  Serial.printf("[%lu] [EBP] TOC item not found\n", millis());
-  return -1;
+  const MutexLock lock(bookDataMutex);
+  const auto item = getCachedSpineItem(spineIndex);
+  return item ? item->tocIndex : -1;
 }
 
 size_t Epub::getBookSize() const {
-  if (spine.empty()) {
+  if (spineCount == 0) {
     return 0;
   }
   return getCumulativeSpineItemSize(getSpineItemsCount() - 1);
@@ -1,13 +1,18 @@
 #pragma once
 #include <Print.h>
+#include <ZipFile.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 
+#include <fstream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "Epub/CacheIndex.h"
 #include "Epub/EpubTocEntry.h"
-
-class ZipFile;
+#include "Epub/LruWindow.h"
 
 class Epub {
   // the title read from the EPUB meta data
@@ -18,34 +23,92 @@ class Epub {
   std::string tocNcxItem;
   // where is the EPUBfile?
   std::string filepath;
+  // The spine and toc are only held in memory while book.bin is being built, afterwards they are paged in from
+  // book.bin through the windows below
   // the spine of the EPUB file
   std::vector<std::pair<std::string, std::string>> spine;
   // the file size of the spine items (proxy to book progress)
   std::vector<size_t> cumulativeSpineItemSize;
   // the toc of the EPUB file
   std::vector<EpubTocEntry> toc;
+  // first toc entry for each spine item, -1 if the spine item has no toc entry
+  std::vector<int> spineToTocIndex;
+  // spine item for each toc entry, -1 if the toc entry does not point into the spine
+  std::vector<int> tocToSpineIndex;
+
+  struct CachedSpineItem {
+    std::string href;
+    size_t cumulativeSize = 0;
+    int tocIndex = -1;
+  };
+  struct CachedTocItem {
+    EpubTocEntry entry;
+    int spineIndex = -1;
+  };
+  // Layout of book.bin, which is only opened to fill the windows on a miss so it doesn't hold an SD handle between
+  // lookups
+  int spineCount = 0;
+  int tocCount = 0;
+  std::streamoff spineTableOffset = 0;
+  std::streamoff tocTableOffset = 0;
+  std::streamoff stringPoolOffset = 0;
+  // Sized to cover a full page of the chapter selection list
+  mutable LruWindow<CachedSpineItem, 32> spineWindow;
+  mutable LruWindow<CachedTocItem, 32> tocWindow;
+  // Guards the windows, the chapter list reads them from its own task while the indexer may be too
+  SemaphoreHandle_t bookDataMutex;
   // the base path for items in the EPUB file
   std::string contentBasePath;
-  // Uniq cache key based on filepath
+  // root of all book caches
+  std::string cacheDir;
+  // Uniq cache key based on the archive's fingerprint, set by load()
   std::string cachePath;
+  // archive handle shared by every item read, see getZip()
+  mutable std::unique_ptr<ZipFile> zip;
+  // size and last use of every book's caches, shared by all books under cacheDir
+  mutable CacheIndex cacheIndex;
+  // limit on the size of everything in cacheDir, 0 for no limit
+  uint64_t cacheBudget = 0;
 
+  bool resolveCachePath();
+  void migrateLegacyCache() const;
   bool findContentOpfFile(std::string* contentOpfFile) const;
   bool parseContentOpf(const std::string& contentOpfFilePath);
   bool parseTocNcxFile();
   void initializeSpineItemSizes();
-  static bool getItemSize(const ZipFile& zip, const std::string& itemHref, size_t* size);
+  void initializeSpineTocIndex();
+  std::string getBookMetadataPath() const;
+  bool loadBookMetadata();
+  bool saveBookMetadata() const;
+  void releaseBookMetadataBuildData();
+  // Called with bookDataMutex held, the item is only valid until the next lookup
+  const CachedSpineItem* getCachedSpineItem(int spineIndex) const;
+  const CachedTocItem* getCachedTocItem(int tocIndex) const;
+  std::string readBookString(std::istream& bookFile, uint32_t offset, uint32_t length) const;
+  std::string getZipIndexPath() const;
+  const ZipFile& getZip() const;
 
  public:
-  explicit Epub(std::string filepath, const std::string& cacheDir) : filepath(std::move(filepath)) {
-    // create a cache key based on the filepath
-    cachePath = cacheDir + "/epub_" + std::to_string(std::hash<std::string>{}(this->filepath));
-  }
-  ~Epub() = default;
+  explicit Epub(std::string filepath, std::string cacheDir)
+      : filepath(std::move(filepath)),
+        cacheDir(std::move(cacheDir)),
+        cacheIndex(this->cacheDir),
+        bookDataMutex(xSemaphoreCreateMutex()) {}
+  ~Epub();
   std::string& getBasePath() { return contentBasePath; }
-  bool load();
+  // Builds the book's metadata if it isn't cached yet, unless buildIfMissing is false in which case that fails instead
+  bool load(bool buildIfMissing = true);
   bool clearCache() const;
   void setupCacheDir() const;
   const std::string& getCachePath() const;
+  // Least recently used caches of any book are removed to keep cacheDir within bytes, 0 for no limit
+  void setCacheBudget(const uint64_t bytes) { cacheBudget = bytes; }
+  uint64_t getCacheBudget() const { return cacheBudget; }
+  // Space the caches of every book take up on SD, as last measured
+  uint64_t getCacheUsage() const { return cacheIndex.getTotalSize(); }
+  // Records a directory in this book's cache as just used. Once it has grown it is measured again and other caches are
+  // trimmed to the budget.
+  void recordCacheUse(const std::string& path, bool grown) const;
   const std::string& getPath() const;
   const std::string& getTitle() const;
   std::string getCoverBmpPath() const;
@@ -53,11 +116,12 @@ class Epub {
   uint8_t* readItemContentsToBytes(const std::string& itemHref, size_t* size = nullptr,
                                    bool trailingNullByte = false) const;
   bool readItemContentsToStream(const std::string& itemHref, Print& out, size_t chunkSize) const;
+  std::unique_ptr<ZipEntryReader> openItemContentsReader(const std::string& itemHref, size_t chunkSize) const;
   bool getItemSize(const std::string& itemHref, size_t* size) const;
-  std::string& getSpineItem(int spineIndex);
+  std::string getSpineItem(int spineIndex) const;
   int getSpineItemsCount() const;
   size_t getCumulativeSpineItemSize(const int spineIndex) const;
-  EpubTocEntry& getTocItem(int tocIndex);
+  EpubTocEntry getTocItem(int tocIndex) const;
   int getTocItemsCount() const;
   int getSpineIndexForTocIndex(int tocIndex) const;
   int getTocIndexForSpineIndex(int spineIndex) const;
@@ -0,0 +1,93 @@
+#include "BookPagination.h"
+
+#include <HardwareSerial.h>
+#include <SD.h>
+#include <Serialization.h>
+
+#include <fstream>
+
+namespace {
+constexpr uint8_t PAGINATION_FILE_VERSION = 1;
+}
+
+void BookPagination::load() {
+  if (!SD.exists(filePath.c_str())) {
+    return;
+  }
+
+  std::ifstream inputFile("/sd" + filePath);
+  uint8_t version;
+  uint32_t count;
+  serialization::readPod(inputFile, version);
+  serialization::readPod(inputFile, count);
+  if (!inputFile || version != PAGINATION_FILE_VERSION || count != pageCounts.size()) {
+    Serial.printf("[%lu] [BPG] Ignoring unreadable pagination\n", millis());
+    return;
+  }
+
+  std::vector<uint32_t> counts(count);
+  inputFile.read(reinterpret_cast<char*>(counts.data()), count * sizeof(uint32_t));
+  if (!inputFile) {
+    Serial.printf("[%lu] [BPG] Ignoring truncated pagination\n", millis());
+    return;
+  }
+
+  pageCounts = std::move(counts);
+  knownCount = 0;
+  for (const uint32_t pageCount : pageCounts) {
+    if (pageCount != UNKNOWN) {
+      knownCount++;
+    }
+  }
+  Serial.printf("[%lu] [BPG] Loaded pagination, %d of %u spine items known\n", millis(), knownCount,
+                pageCounts.size());
+}
+
+bool BookPagination::save() const {
+  std::ofstream outputFile("/sd" + filePath);
+  serialization::writePod(outputFile, PAGINATION_FILE_VERSION);
+  serialization::writePod(outputFile, static_cast<uint32_t>(pageCounts.size()));
+  outputFile.write(reinterpret_cast<const char*>(pageCounts.data()), pageCounts.size() * sizeof(uint32_t));
+
+  if (!outputFile.good()) {
+    Serial.printf("[%lu] [BPG] Failed to write pagination\n", millis());
+    return false;
+  }
+  return true;
+}
+
+void BookPagination::setPageCount(const int spineIndex, const int pageCount) {
+  if (spineIndex < 0 || spineIndex >= static_cast<int>(pageCounts.size()) || pageCount < 0 ||
+      pageCounts[spineIndex] == static_cast<uint32_t>(pageCount)) {
+    return;
+  }
+
+  if (pageCounts[spineIndex] == UNKNOWN) {
+    knownCount++;
+  }
+  pageCounts[spineIndex] = static_cast<uint32_t>(pageCount);
+  save();
+}
+
+bool BookPagination::isKnown(const int spineIndex) const {
+  return spineIndex >= 0 && spineIndex < static_cast<int>(pageCounts.size()) && pageCounts[spineIndex] != UNKNOWN;
+}
+
+int BookPagination::nextUnknown() const {
+  for (size_t i = 0; i < pageCounts.size(); i++) {
+    if (pageCounts[i] == UNKNOWN) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+uint32_t BookPagination::getPageOffset(const int spineIndex) const {
+  uint32_t offset = 0;
+  for (int i = 0; i < spineIndex && i < static_cast<int>(pageCounts.size()); i++) {
+    if (pageCounts[i] != UNKNOWN) {
+      offset += pageCounts[i];
+    }
+  }
+  return offset;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Page count of every spine item for one layout, so pages can be numbered across the whole book once every chapter
+ * has been built.
+ *
+ * Kept next to the section caches of the layout it describes and written as each count becomes known, so it fills in
+ * over however many sessions it takes.
+ */
+class BookPagination {
+  static constexpr uint32_t UNKNOWN = UINT32_MAX;
+
+  std::string filePath;
+  std::vector<uint32_t> pageCounts;
+  int knownCount = 0;
+
+  bool save() const;
+
+ public:
+  explicit BookPagination(std::string filePath, int spineCount)
+      : filePath(std::move(filePath)), pageCounts(spineCount, UNKNOWN) {}
+
+  void load();
+  // Saved straight away if it changes anything
+  void setPageCount(int spineIndex, int pageCount);
+  bool isKnown(int spineIndex) const;
+  // First spine item without a page count, -1 once they are all known
+  int nextUnknown() const;
+  bool isComplete() const { return knownCount == static_cast<int>(pageCounts.size()); }
+  // Pages before the spine item, only meaningful once the pagination is complete
+  uint32_t getPageOffset(int spineIndex) const;
+  uint32_t getTotalPages() const { return getPageOffset(static_cast<int>(pageCounts.size())); }
+};
@@ -0,0 +1,231 @@
+#include "CacheIndex.h"
+
+#include <HardwareSerial.h>
+#include <SD.h>
+#include <Serialization.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "FsHelpers.h"
+
+namespace {
+constexpr uint8_t CACHE_INDEX_FILE_VERSION = 1;
+
+bool isWithin(const std::string& path, const std::string& dir) {
+  return path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0 && path[dir.size()] == '/';
+}
+
+bool endsWith(const std::string& name, const char* suffix) {
+  const size_t length = strlen(suffix);
+  return name.size() >= length && name.compare(name.size() - length, length, suffix) == 0;
+}
+
+// Files in a book's directory that are built from the book again when it is next opened. Anything else, like the
+// reading position in progress.bin, is the reader's own and survives eviction.
+bool isRebuildable(const std::string& name) {
+  return name == "book.bin" || name == "zip_index.bin" || name == "cover.bmp" || name == "prerender.bin" ||
+         endsWith(name, ".tokens.bin") || endsWith(name, ".inflate.bin");
+}
+}  // namespace
+
+void CacheIndex::load() {
+  loaded = true;
+  if (!SD.exists(filePath.c_str())) {
+    scan();
+    return;
+  }
+
+  std::ifstream inputFile("/sd" + filePath);
+  uint8_t version;
+  uint32_t count;
+  serialization::readPod(inputFile, version);
+  serialization::readPod(inputFile, useCounter);
+  serialization::readPod(inputFile, count);
+  if (!inputFile || version != CACHE_INDEX_FILE_VERSION || count > MAX_ENTRIES) {
+    Serial.printf("[%lu] [CIX] Ignoring unreadable cache index, rebuilding it\n", millis());
+    useCounter = 0;
+    scan();
+    return;
+  }
+
+  Entry entry;
+  for (uint32_t i = 0; i < count; i++) {
+    serialization::readString(inputFile, entry.path);
+    serialization::readPod(inputFile, entry.size);
+    serialization::readPod(inputFile, entry.lastUse);
+    if (!inputFile) {
+      break;
+    }
+    entries.push_back(entry);
+  }
+}
+
+void CacheIndex::scan() {
+  // Caches written before there was an index, or while it was unreadable, count as the least recently used
+  entries.clear();
+  File root = SD.open(rootDir.c_str());
+  if (!root || !root.isDirectory()) {
+    return;
+  }
+
+  File book = root.openNextFile();
+  while (book && entries.size() < MAX_ENTRIES) {
+    if (book.isDirectory()) {
+      const std::string bookPath = rootDir + "/" + book.name();
+      entries.push_back({bookPath, static_cast<uint32_t>(FsHelpers::dirSize(bookPath.c_str())), 0});
+
+      File variant = book.openNextFile();
+      while (variant && entries.size() < MAX_ENTRIES) {
+        if (variant.isDirectory()) {
+          const std::string variantPath = bookPath + "/" + variant.name();
+          entries.push_back({variantPath, static_cast<uint32_t>(FsHelpers::dirSize(variantPath.c_str())), 0});
+        }
+        variant = book.openNextFile();
+      }
+    }
+    book = root.openNextFile();
+  }
+  Serial.printf("[%lu] [CIX] Found %u existing cache directories\n", millis(), entries.size());
+}
+
+bool CacheIndex::save() const {
+  std::ofstream outputFile("/sd" + filePath);
+  serialization::writePod(outputFile, CACHE_INDEX_FILE_VERSION);
+  serialization::writePod(outputFile, useCounter);
+  serialization::writePod(outputFile, static_cast<uint32_t>(entries.size()));
+  for (const auto& entry : entries) {
+    serialization::writeString(outputFile, entry.path);
+    serialization::writePod(outputFile, entry.size);
+    serialization::writePod(outputFile, entry.lastUse);
+  }
+
+  if (!outputFile.good()) {
+    Serial.printf("[%lu] [CIX] Failed to write cache index\n", millis());
+    return false;
+  }
+  return true;
+}
+
+CacheIndex::Entry& CacheIndex::get(const std::string& path) {
+  if (!loaded) {
+    load();
+  }
+
+  for (auto& entry : entries) {
+    if (entry.path == path) {
+      return entry;
+    }
+  }
+  entries.push_back({path, 0, 0});
+  return entries.back();
+}
+
+void CacheIndex::touch(const std::string& path) { get(path).lastUse = ++useCounter; }
+
+void CacheIndex::measure(const std::string& path) {
+  get(path).size = static_cast<uint32_t>(FsHelpers::dirSize(path.c_str()));
+}
+
+bool CacheIndex::isBookDir(const std::string& path) const {
+  return isWithin(path, rootDir) && path.find('/', rootDir.size() + 1) == std::string::npos;
+}
+
+bool CacheIndex::trimBookDir(const std::string& path) {
+  // Names are collected first, removing entries while reading the directory would skip some
+  std::vector<std::string> dirs;
+  std::vector<std::string> files;
+  const std::string sdPath = "/sd" + path;
+  DIR* dir = opendir(sdPath.c_str());
+  if (!dir) {
+    return false;
+  }
+  struct stat fileStat;
+  while (const dirent* entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name == "." || name == ".." || stat((sdPath + "/" + name).c_str(), &fileStat) != 0) {
+      continue;
+    }
+    if (S_ISDIR(fileStat.st_mode)) {
+      dirs.push_back(path + "/" + name);
+    } else if (isRebuildable(name)) {
+      files.push_back(path + "/" + name);
+    }
+  }
+  closedir(dir);
+
+  bool removed = true;
+  for (const auto& variant : dirs) {
+    removed &= FsHelpers::removeDir(variant.c_str());
+  }
+  for (const auto& file : files) {
+    removed &= SD.remove(file.c_str());
+  }
+  return removed;
+}
+
+void CacheIndex::removeEntries(const std::string& path) {
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [&path](const Entry& entry) {
+                                 return entry.path == path || isWithin(entry.path, path);
+                               }),
+                entries.end());
+}
+
+void CacheIndex::forget(const std::string& path) {
+  if (!loaded) {
+    load();
+  }
+  removeEntries(path);
+}
+
+uint64_t CacheIndex::getTotalSize() {
+  if (!loaded) {
+    load();
+  }
+
+  uint64_t total = 0;
+  for (const auto& entry : entries) {
+    total += entry.size;
+  }
+  return total;
+}
+
+void CacheIndex::enforceBudget(const uint64_t budgetBytes, const std::string& inUse) {
+  uint64_t total = getTotalSize();
+
+  while (total > budgetBytes) {
+    const Entry* oldest = nullptr;
+    for (const auto& entry : entries) {
+      // Evicting a book's directory takes its variants with it, so the book being read is off limits too
+      if (entry.path == inUse || isWithin(inUse, entry.path)) {
+        continue;
+      }
+      if (!oldest || entry.lastUse < oldest->lastUse) {
+        oldest = &entry;
+      }
+    }
+    if (!oldest) {
+      Serial.printf("[%lu] [CIX] Cache is over budget but everything left is in use\n", millis());
+      return;
+    }
+
+    const std::string path = oldest->path;
+    for (const auto& entry : entries) {
+      if (entry.path == path || isWithin(entry.path, path)) {
+        total -= entry.size;
+      }
+    }
+    Serial.printf("[%lu] [CIX] Evicting cache %s\n", millis(), path.c_str());
+    // A book's directory keeps what can't be rebuilt, it's back in the index with its new size once the book is used
+    const bool removed = isBookDir(path) ? trimBookDir(path) : FsHelpers::removeDir(path.c_str());
+    if (SD.exists(path.c_str()) && !removed) {
+      // Forgotten either way so eviction can't get stuck on it
+      Serial.printf("[%lu] [CIX] Failed to remove %s\n", millis(), path.c_str());
+    }
+    removeEntries(path);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Size and last use of every cache directory under the cache root, so the least recently used ones can be removed to
+ * keep the caches within a budget on SD.
+ *
+ * Entries are either a book's cache directory, sized by its own files, or one of the book's layout variant directories
+ * below it. Evicting a book's directory removes its variants and the files that are rebuilt from the book, but keeps
+ * the directory itself with the reading position and anything else that can't be rebuilt. Last use is a counter bumped
+ * on every touch rather than a time, there's no clock that survives a restart. Persisted to a single small file in the
+ * cache root, directories that predate the file are picked up on first load.
+ */
+class CacheIndex {
+  static constexpr size_t MAX_ENTRIES = 1024;
+
+  struct Entry {
+    std::string path;
+    uint32_t size = 0;
+    uint32_t lastUse = 0;
+  };
+
+  std::string rootDir;
+  std::string filePath;
+  std::vector<Entry> entries;
+  uint32_t useCounter = 0;
+  bool loaded = false;
+
+  void load();
+  void scan();
+  Entry& get(const std::string& path);
+  void removeEntries(const std::string& path);
+  bool isBookDir(const std::string& path) const;
+  // Removes everything in a book's directory that is rebuilt when the book is next opened
+  static bool trimBookDir(const std::string& path);
+
+ public:
+  explicit CacheIndex(std::string rootDir)
+      : rootDir(std::move(rootDir)), filePath(this->rootDir + "/cache_index.bin") {}
+
+  // Marks the directory as just used, adding it if it isn't known yet
+  void touch(const std::string& path);
+  // Updates the recorded size from what is on SD
+  void measure(const std::string& path);
+  // Forgets the directory and everything below it, for when it has been removed
+  void forget(const std::string& path);
+  // Evicts least recently used directories until the total fits budgetBytes. inUse and the directories above it are
+  // never evicted.
+  void enforceBudget(uint64_t budgetBytes, const std::string& inUse);
+  // Recorded size of every directory together
+  uint64_t getTotalSize();
+  bool save() const;
+};
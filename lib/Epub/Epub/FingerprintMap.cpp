@@ -0,0 +1,93 @@
+#include "FingerprintMap.h"
+
+#include <HardwareSerial.h>
+#include <SD.h>
+#include <Serialization.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+constexpr uint8_t FINGERPRINT_FILE_VERSION = 1;
+}
+
+void FingerprintMap::load() {
+  loaded = true;
+  if (!SD.exists(filePath.c_str())) {
+    return;
+  }
+
+  std::ifstream inputFile("/sd" + filePath);
+  uint8_t version;
+  uint32_t count;
+  serialization::readPod(inputFile, version);
+  serialization::readPod(inputFile, count);
+  if (!inputFile || version != FINGERPRINT_FILE_VERSION) {
+    Serial.printf("[%lu] [FPM] Ignoring unreadable fingerprint map\n", millis());
+    return;
+  }
+
+  std::string path;
+  ZipFingerprint fingerprint;
+  for (uint32_t i = 0; i < count && i < MAX_ENTRIES; i++) {
+    serialization::readString(inputFile, path);
+    serialization::readPod(inputFile, fingerprint);
+    if (!inputFile) {
+      break;
+    }
+    if (fingerprints.emplace(path, fingerprint).second) {
+      order.push_back(path);
+    }
+  }
+}
+
+bool FingerprintMap::save() const {
+  std::ofstream outputFile("/sd" + filePath);
+  serialization::writePod(outputFile, FINGERPRINT_FILE_VERSION);
+  serialization::writePod(outputFile, static_cast<uint32_t>(order.size()));
+  for (const auto& path : order) {
+    serialization::writeString(outputFile, path);
+    serialization::writePod(outputFile, fingerprints.at(path));
+  }
+
+  if (!outputFile.good()) {
+    Serial.printf("[%lu] [FPM] Failed to write fingerprint map\n", millis());
+    return false;
+  }
+  return true;
+}
+
+bool FingerprintMap::resolve(const std::string& path, const ZipFile& zip, ZipFingerprint* fingerprint) {
+  if (!loaded) {
+    load();
+  }
+
+  ZipFingerprint trailer;
+  if (!zip.readTrailer(&trailer)) {
+    return false;
+  }
+
+  const auto known = fingerprints.find(path);
+  if (known != fingerprints.end() && known->second.archiveSize == trailer.archiveSize &&
+      known->second.centralDirectoryOffset == trailer.centralDirectoryOffset &&
+      known->second.centralDirectorySize == trailer.centralDirectorySize &&
+      known->second.trailerCrc == trailer.trailerCrc) {
+    *fingerprint = known->second;
+    return true;
+  }
+
+  if (!zip.getFingerprint(fingerprint)) {
+    return false;
+  }
+
+  if (known == fingerprints.end()) {
+    order.push_back(path);
+    if (order.size() > MAX_ENTRIES) {
+      fingerprints.erase(order.front());
+      order.erase(order.begin());
+    }
+  }
+  fingerprints[path] = *fingerprint;
+  save();
+  return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <ZipFile.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Remembers the fingerprint last computed for each book path so reopening a book only needs the zip trailer.
+ *
+ * An entry is only trusted while the archive size, central directory location and trailer CRC still match the file on
+ * disk, anything else is fingerprinted again. Persisted to a single small file, oldest paths are dropped past
+ * MAX_ENTRIES.
+ */
+class FingerprintMap {
+  static constexpr size_t MAX_ENTRIES = 64;
+
+  std::string filePath;
+  std::unordered_map<std::string, ZipFingerprint> fingerprints;
+  // Paths in the order they were added, used to drop the oldest
+  std::vector<std::string> order;
+  bool loaded = false;
+
+  void load();
+  bool save() const;
+
+ public:
+  explicit FingerprintMap(std::string filePath) : filePath(std::move(filePath)) {}
+
+  // Returns the fingerprint for the archive, reusing the remembered one when the trailer still matches
+  bool resolve(const std::string& path, const ZipFile& zip, ZipFingerprint* fingerprint);
+};
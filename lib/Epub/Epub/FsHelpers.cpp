@@ -1,6 +1,10 @@
 #include "FsHelpers.h"
 
 #include <SD.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <string>
 
 bool FsHelpers::removeDir(const char* path) {
   // 1. Open the directory
@@ -34,3 +38,23 @@ bool FsHelpers::removeDir(const char* path) {
 
   return SD.rmdir(path);
 }
+
+uint64_t FsHelpers::dirSize(const char* path) {
+  // Sizes come from stat() rather than opening each file, so this needs no file handles and can't stop short when
+  // they are all in use
+  const std::string dirPath = std::string("/sd") + path;
+  DIR* dir = opendir(dirPath.c_str());
+  if (!dir) {
+    return 0;
+  }
+
+  uint64_t size = 0;
+  struct stat fileStat;
+  while (const dirent* entry = readdir(dir)) {
+    if (stat((dirPath + "/" + entry->d_name).c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
+      size += fileStat.st_size;
+    }
+  }
+  closedir(dir);
+  return size;
+}
@@ -1,6 +1,9 @@
 #pragma once
+#include <cstdint>
 
 class FsHelpers {
  public:
   static bool removeDir(const char* path);
+  // Total size of the files directly in path, subdirectories aren't included
+  static uint64_t dirSize(const char* path);
 };
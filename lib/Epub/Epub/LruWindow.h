@@ -0,0 +1,51 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+// Fixed size window of recently used values keyed by index, the least recently used slot is reused on insert
+template <typename T, size_t N>
+class LruWindow {
+  struct Slot {
+    int key = -1;
+    uint32_t lastUsed = 0;
+    T value;
+  };
+
+  std::array<Slot, N> slots;
+  uint32_t useCounter = 0;
+
+ public:
+  T* find(const int key) {
+    for (auto& slot : slots) {
+      if (slot.key == key) {
+        slot.lastUsed = ++useCounter;
+        return &slot.value;
+      }
+    }
+    return nullptr;
+  }
+
+  T& insert(const int key) {
+    Slot* victim = &slots[0];
+    for (auto& slot : slots) {
+      if (slot.key == -1) {
+        victim = &slot;
+        break;
+      }
+      if (slot.lastUsed < victim->lastUsed) {
+        victim = &slot;
+      }
+    }
+
+    victim->key = key;
+    victim->lastUsed = ++useCounter;
+    return victim->value;
+  }
+
+  void clear() {
+    for (auto& slot : slots) {
+      slot.key = -1;
+      slot.value = T();
+    }
+  }
+};
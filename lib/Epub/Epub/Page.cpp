@@ -3,28 +3,39 @@
 #include <HardwareSerial.h>
 #include <Serialization.h>
 
+#include <sstream>
+
 namespace {
-constexpr uint8_t PAGE_FILE_VERSION = 3;
+constexpr uint8_t PAGE_FILE_VERSION = 5;
 }
 
 void PageLine::render(GfxRenderer& renderer, const int fontId) { block->render(renderer, fontId, xPos, yPos); }
 
-void PageLine::serialize(std::ostream& os) {
-  serialization::writePod(os, xPos);
-  serialization::writePod(os, yPos);
+void PageLine::serialize(std::ostream& os, StringTable& strings) {
+  serialization::writeSignedVarint(os, xPos);
+  serialization::writeSignedVarint(os, yPos);
 
   // serialize TextBlock pointed to by PageLine
-  block->serialize(os);
+  block->serialize(os, strings);
 }
 
-std::unique_ptr<PageLine> PageLine::deserialize(std::istream& is) {
-  int16_t xPos;
-  int16_t yPos;
-  serialization::readPod(is, xPos);
-  serialization::readPod(is, yPos);
+const uint8_t* PageLine::skipSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings) {
+  int32_t xPos, yPos;
+  if (!serialization::readSignedVarint(p, end, xPos) || !serialization::readSignedVarint(p, end, yPos)) {
+    return nullptr;
+  }
+  return TextBlock::skipSerialized(p, end, strings);
+}
 
-  auto tb = TextBlock::deserialize(is);
-  return std::unique_ptr<PageLine>(new PageLine(std::move(tb), xPos, yPos));
+const uint8_t* PageLine::renderSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings,
+                                          GfxRenderer& renderer, const int fontId) {
+  int32_t xPos, yPos;
+  serialization::readSignedVarint(p, end, xPos);
+  serialization::readSignedVarint(p, end, yPos);
+
+  const uint8_t* blockEnd = TextBlock::skipSerialized(p, end, strings);
+  TextBlock::renderSerialized(p, blockEnd, strings, renderer, fontId, xPos, yPos);
+  return blockEnd;
 }
 
 void Page::render(GfxRenderer& renderer, const int fontId) const {
@@ -34,43 +45,69 @@ void Page::render(GfxRenderer& renderer, const int fontId) const {
 }
 
 void Page::serialize(std::ostream& os) const {
-  serialization::writePod(os, PAGE_FILE_VERSION);
-
-  const uint32_t count = elements.size();
-  serialization::writePod(os, count);
-
+  // The lines go through the table first, so it holds exactly the words they use by the time it is written
+  StringTable strings;
+  std::ostringstream lines;
   for (const auto& el : elements) {
     // Only PageLine exists currently
-    serialization::writePod(os, static_cast<uint8_t>(TAG_PageLine));
-    el->serialize(os);
+    serialization::writePod(lines, static_cast<uint8_t>(TAG_PageLine));
+    el->serialize(lines, strings);
   }
+
+  serialization::writePod(os, PAGE_FILE_VERSION);
+  strings.serialize(os);
+  serialization::writeVarint(os, elements.size());
+  os << lines.str();
 }
 
-std::unique_ptr<Page> Page::deserialize(std::istream& is) {
-  uint8_t version;
-  serialization::readPod(is, version);
-  if (version != PAGE_FILE_VERSION) {
-    Serial.printf("[%lu] [PGE] Deserialization failed: Unknown version %u\n", millis(), version);
+std::unique_ptr<PageView> PageView::create(std::unique_ptr<uint8_t[]> data, const size_t size) {
+  const uint8_t* p = data.get();
+  const uint8_t* end = p + size;
+
+  if (p == end || *p != PAGE_FILE_VERSION) {
+    Serial.printf("[%lu] [PGE] Deserialization failed: Unknown version %u\n", millis(), p == end ? 0 : *p);
     return nullptr;
   }
+  p++;
 
-  auto page = std::unique_ptr<Page>(new Page());
+  auto view = std::unique_ptr<PageView>(new PageView(std::move(data), size));
+  p = view->strings.view(p, end);
+  if (!p) {
+    Serial.printf("[%lu] [PGE] Deserialization failed: Invalid string table\n", millis());
+    return nullptr;
+  }
+  view->elementsOffset = p - view->data.get();
 
+  // Walk the whole page once up front so rendering can trust every count, offset and string index
   uint32_t count;
-  serialization::readPod(is, count);
-
+  if (!serialization::readVarint(p, end, count)) {
+    Serial.printf("[%lu] [PGE] Deserialization failed: Truncated page\n", millis());
+    return nullptr;
+  }
   for (uint32_t i = 0; i < count; i++) {
-    uint8_t tag;
-    serialization::readPod(is, tag);
-
-    if (tag == TAG_PageLine) {
-      auto pl = PageLine::deserialize(is);
-      page->elements.push_back(std::move(pl));
-    } else {
+    const uint8_t tag = p < end ? *p++ : 0;
+    if (tag != TAG_PageLine) {
       Serial.printf("[%lu] [PGE] Deserialization failed: Unknown tag %u\n", millis(), tag);
       return nullptr;
     }
+    p = PageLine::skipSerialized(p, end, view->strings);
+    if (!p) {
+      Serial.printf("[%lu] [PGE] Deserialization failed: Invalid page line\n", millis());
+      return nullptr;
+    }
   }
 
-  return page;
+  return view;
+}
+
+void PageView::render(GfxRenderer& renderer, const int fontId) const {
+  const uint8_t* p = data.get() + elementsOffset;
+  const uint8_t* end = data.get() + size;
+
+  uint32_t count;
+  serialization::readVarint(p, end, count);
+  for (uint32_t i = 0; i < count; i++) {
+    p++;  // tag, only PageLine exists currently
+    p = PageLine::renderSerialized(p, end, strings, renderer, fontId);
+  }
 }
@@ -2,6 +2,7 @@
 #include <utility>
 #include <vector>
 
+#include "StringTable.h"
 #include "blocks/TextBlock.h"
 
 enum PageElementTag : uint8_t {
@@ -16,7 +17,7 @@ class PageElement {
   explicit PageElement(const int16_t xPos, const int16_t yPos) : xPos(xPos), yPos(yPos) {}
   virtual ~PageElement() = default;
   virtual void render(GfxRenderer& renderer, int fontId) = 0;
-  virtual void serialize(std::ostream& os) = 0;
+  virtual void serialize(std::ostream& os, StringTable& strings) = 0;
 };
 
 // a line from a block element
@@ -27,8 +28,10 @@ class PageLine final : public PageElement {
   PageLine(std::shared_ptr<TextBlock> block, const int16_t xPos, const int16_t yPos)
       : PageElement(xPos, yPos), block(std::move(block)) {}
   void render(GfxRenderer& renderer, int fontId) override;
-  void serialize(std::ostream& os) override;
-  static std::unique_ptr<PageLine> deserialize(std::istream& is);
+  void serialize(std::ostream& os, StringTable& strings) override;
+  static const uint8_t* skipSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings);
+  static const uint8_t* renderSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings,
+                                         GfxRenderer& renderer, int fontId);
 };
 
 class Page {
@@ -36,6 +39,23 @@ class Page {
   // the list of block index and line numbers on this page
   std::vector<std::shared_ptr<PageElement>> elements;
   void render(GfxRenderer& renderer, int fontId) const;
+  // Written with a table of the page's words up front, the lines refer to words by their index in it
   void serialize(std::ostream& os) const;
-  static std::unique_ptr<Page> deserialize(std::istream& is);
+};
+
+// A serialized page loaded into a single buffer and rendered straight from it, words are drawn from the page's string
+// table in the same buffer so nothing is allocated per line or word
+class PageView {
+  std::unique_ptr<uint8_t[]> data;
+  size_t size;
+  StringTable strings;
+  // Where the elements start, after the string table
+  size_t elementsOffset = 0;
+
+  PageView(std::unique_ptr<uint8_t[]> data, const size_t size) : data(std::move(data)), size(size) {}
+
+ public:
+  // Takes ownership of a buffer holding one page as written by Page::serialize, nullptr if it is malformed
+  static std::unique_ptr<PageView> create(std::unique_ptr<uint8_t[]> data, size_t size);
+  void render(GfxRenderer& renderer, int fontId) const;
 };
@@ -1,34 +1,119 @@
 #include "Section.h"
 
+#include <Esp.h>
+#include <LzssStream.h>
 #include <SD.h>
 #include <Serialization.h>
+#include <unistd.h>
 
 #include <fstream>
+#include <sstream>
 
-#include "FsHelpers.h"
 #include "Page.h"
 #include "parsers/ChapterHtmlSlimParser.h"
 
 namespace {
-constexpr uint8_t SECTION_FILE_VERSION = 5;
+constexpr uint8_t SECTION_FILE_VERSION = 11;
+// Byte offset of the page count and page table position in the header, patched once the section is built
+constexpr std::streamoff PAGE_TABLE_FIELDS_OFFSET =
+    sizeof(uint8_t) + sizeof(int) + sizeof(float) + 4 * sizeof(int) + sizeof(bool);
+// Page cache sizing, pages are a few KB decoded so this keeps well clear of what the renderer and parser need
+constexpr size_t MAX_CACHED_PAGES = 5;
+constexpr uint32_t PAGE_CACHE_ROOMY_HEAP = 96 * 1024;
+constexpr uint32_t PAGE_CACHE_MIN_HEAP = 48 * 1024;
+// Each checkpoint costs ~43KB on SD, so only long chapters get them
+constexpr size_t INFLATE_CHECKPOINT_INTERVAL = 256 * 1024;
+constexpr uint8_t RESUME_FILE_VERSION = 3;
+constexpr uint8_t RESUME_RECORD_END = 0x5A;
+// Every checkpoint closes and reopens the section file to commit its pages to SD, so they are spaced out a little
+constexpr size_t RESUME_CHECKPOINT_PAGE_INTERVAL = 8;
+constexpr uint32_t MAX_RESUME_RECORD_SIZE = 256 * 1024;
+constexpr uint8_t TOKEN_FILE_VERSION = 1;
+
+// Depths are INT_MAX when not in effect, stored as 0 so they stay a single byte
+void writeDepth(std::ostream& os, const int depth) {
+  serialization::writeVarint(os, depth == INT_MAX ? 0 : static_cast<uint32_t>(depth) + 1);
 }
 
-void Section::onPageComplete(std::unique_ptr<Page> page) {
-  const auto filePath = cachePath + "/page_" + std::to_string(pageCount) + ".bin";
+void readDepth(std::istream& is, int& depth) {
+  uint32_t value;
+  serialization::readVarint(is, value);
+  depth = value == 0 ? INT_MAX : static_cast<int>(value) - 1;
+}
 
-  std::ofstream outputFile("/sd" + filePath);
-  page->serialize(outputFile);
-  outputFile.close();
+// FNV-1a
+template <typename T>
+void hashPod(uint32_t& hash, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  for (size_t i = 0; i < sizeof(T); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+}
+}  // namespace
+
+void Section::selectLayout(const int fontId, const float lineCompression, const int marginTop, const int marginRight,
+                           const int marginBottom, const int marginLeft, const bool extraParagraphSpacing) {
+  // Collisions are harmless, the section header still has to match the parameters exactly
+  uint32_t hash = 2166136261u;
+  hashPod(hash, fontId);
+  hashPod(hash, lineCompression);
+  hashPod(hash, marginTop);
+  hashPod(hash, marginRight);
+  hashPod(hash, marginBottom);
+  hashPod(hash, marginLeft);
+  hashPod(hash, extraParagraphSpacing);
+
+  char name[20];
+  snprintf(name, sizeof(name), "/layout_%08x", hash);
+  layoutDir = epub->getCachePath() + name;
+  filePath = layoutDir + "/section_" + std::to_string(spineIndex) + ".bin";
+}
+
+// Inflate checkpoints don't depend on the layout, so every variant shares them
+std::string Section::getCheckpointPath() const {
+  return epub->getCachePath() + "/section_" + std::to_string(spineIndex) + ".inflate.bin";
+}
+
+// Token streams don't depend on the layout either
+std::string Section::getTokensPath() const {
+  return epub->getCachePath() + "/section_" + std::to_string(spineIndex) + ".tokens.bin";
+}
+
+bool Section::openTokenStream(std::ifstream& file) const {
+  const auto tokensPath = getTokensPath();
+  if (!SD.exists(tokensPath.c_str())) {
+    return false;
+  }
+
+  file.open("/sd" + tokensPath, std::ios::binary);
+  uint8_t version = 0;
+  uint8_t complete = 0;
+  serialization::readPod(file, version);
+  serialization::readPod(file, complete);
+  if (!file || version != TOKEN_FILE_VERSION || complete != 1) {
+    file.close();
+    return false;
+  }
+  return true;
+}
+
+std::string Section::getResumePath() const {
+  return layoutDir + "/section_" + std::to_string(spineIndex) + ".resume.bin";
+}
+
+void Section::onPageComplete(std::unique_ptr<Page> page) {
+  pageOffsets.push_back(pageWriter->position());
+  page->serialize(*pageStream);
+  pagesEnd = pageWriter->position();
 
   Serial.printf("[%lu] [SCT] Page %d processed\n", millis(), pageCount);
 
   pageCount++;
 }
 
-void Section::writeCacheMetadata(const int fontId, const float lineCompression, const int marginTop,
-                                 const int marginRight, const int marginBottom, const int marginLeft,
-                                 const bool extraParagraphSpacing) const {
-  std::ofstream outputFile(("/sd" + cachePath + "/section.bin").c_str());
+void Section::writeCacheHeader(const int fontId, const float lineCompression, const int marginTop,
+                               const int marginRight, const int marginBottom, const int marginLeft,
+                               const bool extraParagraphSpacing) {
   serialization::writePod(outputFile, SECTION_FILE_VERSION);
   serialization::writePod(outputFile, fontId);
   serialization::writePod(outputFile, lineCompression);
@@ -37,75 +122,150 @@ void Section::writeCacheMetadata(const int fontId, const float lineCompression,
   serialization::writePod(outputFile, marginBottom);
   serialization::writePod(outputFile, marginLeft);
   serialization::writePod(outputFile, extraParagraphSpacing);
-  serialization::writePod(outputFile, pageCount);
+  // Page count and table position stay zero until the section is complete, so a partly written file is never
+  // mistaken for a valid one
+  serialization::writePod(outputFile, static_cast<uint32_t>(0));
+  serialization::writePod(outputFile, static_cast<uint32_t>(0));
+}
+
+void Section::startPageWriter() {
+  pageWriter.reset(new WriteBehindBuffer(outputFile));
+  pageStream.reset(new std::ostream(pageWriter.get()));
+}
+
+// Waits for the pages still queued to be written, outputFile can be used directly again afterwards
+bool Section::stopPageWriter() {
+  if (!pageWriter) {
+    return true;
+  }
+  const bool written = static_cast<bool>(pageStream->flush());
+  pageStream.reset();
+  pageWriter.reset();
+  return written;
+}
+
+bool Section::finishCacheFile() {
+  if (!stopPageWriter()) {
+    outputFile.close();
+    return false;
+  }
+
+  const auto pageTableOffset = static_cast<uint32_t>(outputFile.tellp());
+  for (const uint32_t offset : pageOffsets) {
+    serialization::writePod(outputFile, offset);
+  }
+
+  outputFile.seekp(PAGE_TABLE_FIELDS_OFFSET);
+  serialization::writePod(outputFile, static_cast<uint32_t>(pageCount));
+  serialization::writePod(outputFile, pageTableOffset);
+  const bool success = outputFile.good();
   outputFile.close();
+  return success;
+}
+
+bool Section::headerMatches(std::istream& file, const int fontId, const float lineCompression, const int marginTop,
+                            const int marginRight, const int marginBottom, const int marginLeft,
+                            const bool extraParagraphSpacing) const {
+  uint8_t version;
+  serialization::readPod(file, version);
+  if (version != SECTION_FILE_VERSION) {
+    Serial.printf("[%lu] [SCT] Deserialization failed: Unknown version %u\n", millis(), version);
+    return false;
+  }
+
+  int fileFontId, fileMarginTop, fileMarginRight, fileMarginBottom, fileMarginLeft;
+  float fileLineCompression;
+  bool fileExtraParagraphSpacing;
+  serialization::readPod(file, fileFontId);
+  serialization::readPod(file, fileLineCompression);
+  serialization::readPod(file, fileMarginTop);
+  serialization::readPod(file, fileMarginRight);
+  serialization::readPod(file, fileMarginBottom);
+  serialization::readPod(file, fileMarginLeft);
+  serialization::readPod(file, fileExtraParagraphSpacing);
+
+  if (fontId != fileFontId || lineCompression != fileLineCompression || marginTop != fileMarginTop ||
+      marginRight != fileMarginRight || marginBottom != fileMarginBottom || marginLeft != fileMarginLeft ||
+      extraParagraphSpacing != fileExtraParagraphSpacing) {
+    Serial.printf("[%lu] [SCT] Deserialization failed: Parameters do not match\n", millis());
+    return false;
+  }
+  return true;
 }
 
 bool Section::loadCacheMetadata(const int fontId, const float lineCompression, const int marginTop,
                                 const int marginRight, const int marginBottom, const int marginLeft,
                                 const bool extraParagraphSpacing) {
-  if (!SD.exists(cachePath.c_str())) {
+  selectLayout(fontId, lineCompression, marginTop, marginRight, marginBottom, marginLeft, extraParagraphSpacing);
+  if (!SD.exists(filePath.c_str())) {
     return false;
   }
 
-  const auto sectionFilePath = cachePath + "/section.bin";
-  if (!SD.exists(sectionFilePath.c_str())) {
+  std::ifstream inputFile("/sd" + filePath);
+  if (!headerMatches(inputFile, fontId, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+                     extraParagraphSpacing)) {
+    inputFile.close();
+    clearCache();
     return false;
   }
 
-  std::ifstream inputFile(("/sd" + sectionFilePath).c_str());
-
-  // Match parameters
-  {
-    uint8_t version;
-    serialization::readPod(inputFile, version);
-    if (version != SECTION_FILE_VERSION) {
-      inputFile.close();
-      Serial.printf("[%lu] [SCT] Deserialization failed: Unknown version %u\n", millis(), version);
-      clearCache();
-      return false;
-    }
+  uint32_t filePageCount, pageTableOffset;
+  serialization::readPod(inputFile, filePageCount);
+  serialization::readPod(inputFile, pageTableOffset);
+  if (!inputFile || pageTableOffset == 0) {
+    // Left in place for persistPageDataToSD() to resume from
+    Serial.printf("[%lu] [SCT] Deserialization failed: Section was not completed\n", millis());
+    return false;
+  }
 
-    int fileFontId, fileMarginTop, fileMarginRight, fileMarginBottom, fileMarginLeft;
-    float fileLineCompression;
-    bool fileExtraParagraphSpacing;
-    serialization::readPod(inputFile, fileFontId);
-    serialization::readPod(inputFile, fileLineCompression);
-    serialization::readPod(inputFile, fileMarginTop);
-    serialization::readPod(inputFile, fileMarginRight);
-    serialization::readPod(inputFile, fileMarginBottom);
-    serialization::readPod(inputFile, fileMarginLeft);
-    serialization::readPod(inputFile, fileExtraParagraphSpacing);
-
-    if (fontId != fileFontId || lineCompression != fileLineCompression || marginTop != fileMarginTop ||
-        marginRight != fileMarginRight || marginBottom != fileMarginBottom || marginLeft != fileMarginLeft ||
-        extraParagraphSpacing != fileExtraParagraphSpacing) {
-      inputFile.close();
-      Serial.printf("[%lu] [SCT] Deserialization failed: Parameters do not match\n", millis());
-      clearCache();
-      return false;
-    }
+  // The offset table is small (4 bytes a page) so it is held in memory, every page load is then a single seek
+  pageOffsets.resize(filePageCount);
+  inputFile.seekg(pageTableOffset);
+  inputFile.read(reinterpret_cast<char*>(pageOffsets.data()), filePageCount * sizeof(uint32_t));
+  if (!inputFile) {
+    Serial.printf("[%lu] [SCT] Deserialization failed: Could not read page table\n", millis());
+    inputFile.close();
+    clearCache();
+    return false;
   }
 
-  serialization::readPod(inputFile, pageCount);
   inputFile.close();
+  pageCount = static_cast<int>(filePageCount);
+  pagesEnd = pageTableOffset;
+  epub->recordCacheUse(layoutDir, false);
   Serial.printf("[%lu] [SCT] Deserialization succeeded: %d pages\n", millis(), pageCount);
   return true;
 }
 
-void Section::setupCacheDir() const {
-  epub->setupCacheDir();
-  SD.mkdir(cachePath.c_str());
-}
+void Section::setupCacheDir() const { epub->setupCacheDir(); }
 
-// Your updated class method (assuming you are using the 'SD' object, which is a wrapper for a specific filesystem)
-bool Section::clearCache() const {
-  if (!SD.exists(cachePath.c_str())) {
+bool Section::clearCache() {
+  // Files can't be removed while they are still open
+  stopPageWriter();
+  outputFile.close();
+  closeResumeFile();
+  partial = false;
+  pageCount = 0;
+  pageCache.clear();
+  pageOffsets.clear();
+
+  // The inflate checkpoints are left alone, they are shared with the builds of this spine item in every other layout
+  // and go with the book's own directory in Epub::clearCache()
+  // No layout picked yet, so there is nothing of this section to remove
+  if (filePath.empty()) {
+    return true;
+  }
+  const auto resumePath = getResumePath();
+  if (SD.exists(resumePath.c_str())) {
+    SD.remove(resumePath.c_str());
+  }
+
+  if (!SD.exists(filePath.c_str())) {
     Serial.printf("[%lu] [SCT] Cache does not exist, no action needed\n", millis());
     return true;
   }
 
-  if (!FsHelpers::removeDir(cachePath.c_str())) {
+  if (!SD.remove(filePath.c_str())) {
     Serial.printf("[%lu] [SCT] Failed to clear cache\n", millis());
     return false;
   }
@@ -114,53 +274,405 @@ bool Section::clearCache() const {
   return true;
 }
 
+bool Section::loadResumePoint(const int fontId, const float lineCompression, const int marginTop,
+                              const int marginRight, const int marginBottom, const int marginLeft,
+                              const bool extraParagraphSpacing, ParseCheckpoint* checkpoint, uint32_t* fileSize,
+                              long* journalSize) {
+  std::ifstream sectionFile("/sd" + filePath);
+  if (!sectionFile || !headerMatches(sectionFile, fontId, lineCompression, marginTop, marginRight, marginBottom,
+                                     marginLeft, extraParagraphSpacing)) {
+    return false;
+  }
+
+  uint32_t filePageCount, pageTableOffset;
+  serialization::readPod(sectionFile, filePageCount);
+  serialization::readPod(sectionFile, pageTableOffset);
+  if (!sectionFile || pageTableOffset != 0) {
+    return false;
+  }
+  sectionFile.seekg(0, std::ios::end);
+  const auto sectionFileSize = static_cast<uint32_t>(sectionFile.tellg());
+  sectionFile.close();
+
+  std::ifstream journal("/sd" + getResumePath());
+  uint8_t version = 0;
+  serialization::readPod(journal, version);
+  if (!journal || version != RESUME_FILE_VERSION) {
+    return false;
+  }
+
+  // Records are applied in order, reading stops at the first one that is incomplete (the build was interrupted while
+  // it was being written) or that refers to pages that didn't make it to SD
+  bool found = false;
+  std::string data;
+  while (true) {
+    uint32_t size = 0;
+    serialization::readPod(journal, size);
+    if (!journal || size <= sizeof(uint32_t) || size > MAX_RESUME_RECORD_SIZE) {
+      break;
+    }
+    data.resize(size);
+    journal.read(&data[0], size);
+    if (!journal || static_cast<uint8_t>(data.back()) != RESUME_RECORD_END) {
+      break;
+    }
+
+    std::istringstream record(data);
+    uint32_t recordFileSize;
+    serialization::readPod(record, recordFileSize);
+    if (recordFileSize > sectionFileSize) {
+      break;
+    }
+
+    uint32_t count;
+    serialization::readVarint(record, count);
+    for (uint32_t i = 0; i < count && record; i++) {
+      uint32_t offset;
+      serialization::readPod(record, offset);
+      pageOffsets.push_back(offset);
+    }
+
+    ParseCheckpoint recordCheckpoint;
+    serialization::readVarint(record, recordCheckpoint.inputOffset);
+    serialization::readPod(record, recordCheckpoint.blockStyle);
+    readDepth(record, recordCheckpoint.skipUntilDepth);
+    readDepth(record, recordCheckpoint.boldUntilDepth);
+    readDepth(record, recordCheckpoint.italicUntilDepth);
+    serialization::readVarint(record, recordCheckpoint.linesToSkip);
+    uint32_t pathLength;
+    serialization::readVarint(record, pathLength);
+    recordCheckpoint.elementPath.resize(pathLength);
+    record.read(&recordCheckpoint.elementPath[0], pathLength);
+    uint32_t encodingLength;
+    serialization::readVarint(record, encodingLength);
+    recordCheckpoint.encoding.resize(encodingLength);
+    record.read(&recordCheckpoint.encoding[0], encodingLength);
+    if (!record) {
+      // Part of it has been applied already, so nothing recovered can be trusted
+      Serial.printf("[%lu] [SCT] Resume journal is corrupt\n", millis());
+      pageOffsets.clear();
+      return false;
+    }
+
+    *checkpoint = std::move(recordCheckpoint);
+    *fileSize = recordFileSize;
+    *journalSize = static_cast<long>(journal.tellg());
+    found = true;
+  }
+
+  if (!found) {
+    pageOffsets.clear();
+  }
+  return found;
+}
+
+void Section::onCheckpoint(const ParseCheckpoint& checkpoint) {
+  if (!resumeFile || pageOffsets.size() - journaledPages < RESUME_CHECKPOINT_PAGE_INTERVAL) {
+    return;
+  }
+
+  // Pages have to reach SD before a checkpoint that refers to them, on FAT closing the file is what commits them
+  pageStream->flush();
+  const auto fileSize = static_cast<uint32_t>(outputFile.tellp());
+  outputFile.close();
+  outputFile.clear();
+  outputFile.open("/sd" + filePath, std::ios::in | std::ios::out);
+  outputFile.seekp(fileSize);
+
+  std::ostringstream record;
+  serialization::writePod(record, fileSize);
+  serialization::writeVarint(record, pageOffsets.size() - journaledPages);
+  for (size_t i = journaledPages; i < pageOffsets.size(); i++) {
+    serialization::writePod(record, pageOffsets[i]);
+  }
+  serialization::writeVarint(record, checkpoint.inputOffset);
+  serialization::writePod(record, checkpoint.blockStyle);
+  writeDepth(record, checkpoint.skipUntilDepth);
+  writeDepth(record, checkpoint.boldUntilDepth);
+  writeDepth(record, checkpoint.italicUntilDepth);
+  serialization::writeVarint(record, checkpoint.linesToSkip);
+  serialization::writeVarint(record, checkpoint.elementPath.size());
+  record.write(checkpoint.elementPath.data(), checkpoint.elementPath.size());
+  serialization::writeVarint(record, checkpoint.encoding.size());
+  record.write(checkpoint.encoding.data(), checkpoint.encoding.size());
+  serialization::writePod(record, RESUME_RECORD_END);
+
+  const std::string data = record.str();
+  const auto size = static_cast<uint32_t>(data.size());
+  if (!outputFile || fwrite(&size, sizeof(size), 1, resumeFile) != 1 ||
+      fwrite(data.data(), 1, size, resumeFile) != size) {
+    Serial.printf("[%lu] [SCT] Failed to write resume checkpoint, no longer recording them\n", millis());
+    closeResumeFile();
+    return;
+  }
+  fflush(resumeFile);
+  fsync(fileno(resumeFile));
+
+  journaledPages = pageOffsets.size();
+  Serial.printf("[%lu] [SCT] Resume checkpoint after page %d\n", millis(), pageCount - 1);
+}
+
+void Section::closeResumeFile() {
+  if (resumeFile) {
+    fclose(resumeFile);
+    resumeFile = nullptr;
+  }
+}
+
 bool Section::persistPageDataToSD(const int fontId, const float lineCompression, const int marginTop,
                                   const int marginRight, const int marginBottom, const int marginLeft,
-                                  const bool extraParagraphSpacing) {
-  const auto localPath = epub->getSpineItem(spineIndex);
+                                  const bool extraParagraphSpacing, const std::function<bool()>& continueFn) {
+  selectLayout(fontId, lineCompression, marginTop, marginRight, marginBottom, marginLeft, extraParagraphSpacing);
+  if (!SD.exists(layoutDir.c_str())) {
+    SD.mkdir(layoutDir.c_str());
+  }
 
-  // TODO: Should we get rid of this file all together?
-  //       It currently saves us a bit of memory by allowing for all the inflation bits to be released
-  //       before loading the XML parser
-  const auto tmpHtmlPath = epub->getCachePath() + "/.tmp_" + std::to_string(spineIndex) + ".html";
-  File f = SD.open(tmpHtmlPath.c_str(), FILE_WRITE, true);
-  bool success = epub->readItemContentsToStream(localPath, f, 1024);
-  f.close();
+  // A chapter parsed by an earlier build, with whatever layout, is laid out again from its token stream without
+  // inflating or parsing it
+  std::ifstream tokenInput;
+  const bool replaying = openTokenStream(tokenInput);
 
-  if (!success) {
-    Serial.printf("[%lu] [SCT] Failed to stream item contents to temp file\n", millis());
-    return false;
+  std::unique_ptr<ZipEntryReader> reader;
+  if (!replaying) {
+    // The chapter is inflated on demand as the parser consumes it, this keeps the inflator and its dictionary
+    // (~44KB) alive alongside the parser but avoids writing and re-reading the whole chapter on SD
+    reader = epub->openItemContentsReader(epub->getSpineItem(spineIndex), 1024);
+    if (!reader) {
+      Serial.printf("[%lu] [SCT] Failed to open item contents\n", millis());
+      return false;
+    }
   }
 
-  Serial.printf("[%lu] [SCT] Streamed temp HTML to %s\n", millis(), tmpHtmlPath.c_str());
+  closeResumeFile();
+  pageCount = 0;
+  pageCache.clear();
+  pageOffsets.clear();
 
-  const auto sdTmpHtmlPath = "/sd" + tmpHtmlPath;
+  // An interrupted build with the same layout carries on from its last checkpoint, with the pages it had recorded up
+  // to there. Replaying tokens is quick enough to always start over.
+  ParseCheckpoint resumePoint;
+  uint32_t resumeFileSize = 0;
+  long journalSize = 0;
+  bool resuming = !replaying && loadResumePoint(fontId, lineCompression, marginTop, marginRight, marginBottom,
+                                                marginLeft, extraParagraphSpacing, &resumePoint, &resumeFileSize,
+                                                &journalSize);
+  if (resuming && !reader->seek(resumePoint.inputOffset, "/sd" + getCheckpointPath())) {
+    Serial.printf("[%lu] [SCT] Could not seek to resume point, starting over\n", millis());
+    pageOffsets.clear();
+    resuming = false;
+  }
 
-  ChapterHtmlSlimParser visitor(sdTmpHtmlPath.c_str(), renderer, fontId, lineCompression, marginTop, marginRight,
-                                marginBottom, marginLeft, extraParagraphSpacing,
-                                [this](std::unique_ptr<Page> page) { this->onPageComplete(std::move(page)); });
-  success = visitor.parseAndBuildPages();
+  outputFile.clear();
+  if (resuming) {
+    Serial.printf("[%lu] [SCT] Resuming build after page %u\n", millis(), pageOffsets.size());
+    outputFile.open("/sd" + filePath, std::ios::in | std::ios::out);
+    outputFile.seekp(resumeFileSize);
+    pagesEnd = resumeFileSize;
+    // Picks up at the end of the last complete record, overwriting anything after it
+    resumeFile = fopen(("/sd" + getResumePath()).c_str(), "r+b");
+    if (resumeFile) {
+      fseek(resumeFile, journalSize, SEEK_SET);
+    }
+  } else {
+    outputFile.open("/sd" + filePath, std::ios::in | std::ios::out | std::ios::trunc);
+    writeCacheHeader(fontId, lineCompression, marginTop, marginRight, marginBottom, marginLeft, extraParagraphSpacing);
+    if (replaying) {
+      // Checkpoints are positions in the chapter, which a replay doesn't have
+      SD.remove(getResumePath().c_str());
+    } else {
+      // Lets later passes resume inflating part way through the chapter rather than from the start
+      reader->recordCheckpoints("/sd" + getCheckpointPath(), INFLATE_CHECKPOINT_INTERVAL);
+      resumeFile = fopen(("/sd" + getResumePath()).c_str(), "wb");
+      if (resumeFile) {
+        fwrite(&RESUME_FILE_VERSION, sizeof(RESUME_FILE_VERSION), 1, resumeFile);
+      }
+    }
+  }
+  startPageWriter();
+  partial = true;
+  pageCount = static_cast<int>(pageOffsets.size());
+  journaledPages = pageOffsets.size();
+
+  // Only a parse of the whole chapter sees all of it, so that is the only one the token stream is recorded from
+  std::ofstream tokenOutput;
+  std::unique_ptr<serialization::LzssOutputBuffer> tokenEncoder;
+  std::unique_ptr<std::ostream> tokenStream;
+  if (!replaying && !resuming) {
+    tokenOutput.open("/sd" + getTokensPath(), std::ios::binary | std::ios::trunc);
+    serialization::writePod(tokenOutput, TOKEN_FILE_VERSION);
+    serialization::writePod(tokenOutput, static_cast<uint8_t>(0));
+    tokenEncoder.reset(new serialization::LzssOutputBuffer(tokenOutput));
+    tokenStream.reset(new std::ostream(tokenEncoder.get()));
+  }
+
+  bool cancelled = false;
+  ChapterHtmlSlimParser visitor(reader.get(), renderer, fontId, lineCompression, marginTop, marginRight, marginBottom,
+                                marginLeft, extraParagraphSpacing,
+                                [this](std::unique_ptr<Page> page) { this->onPageComplete(std::move(page)); },
+                                [&continueFn, &cancelled] {
+                                  cancelled = continueFn && !continueFn();
+                                  return !cancelled;
+                                });
+  bool success;
+  if (replaying) {
+    Serial.printf("[%lu] [SCT] Building pages from token stream\n", millis());
+    serialization::LzssInputBuffer tokenDecoder(tokenInput);
+    std::istream tokens(&tokenDecoder);
+    success = visitor.buildPagesFromTokens(tokens);
+  } else {
+    visitor.setCheckpointFn([this](const ParseCheckpoint& checkpoint) { onCheckpoint(checkpoint); });
+    visitor.setTokenSink(tokenStream.get());
+    if (resuming) {
+      visitor.resumeFrom(resumePoint);
+    }
+    success = visitor.parseAndBuildPages();
+  }
+  tokenInput.close();
+
+  if (tokenStream) {
+    tokenStream.reset();
+    tokenEncoder.reset();
+    if (success) {
+      // Only marked complete once the whole chapter is in it
+      tokenOutput.seekp(sizeof(TOKEN_FILE_VERSION));
+      serialization::writePod(tokenOutput, static_cast<uint8_t>(1));
+    }
+    const bool tokensWritten = tokenOutput.good();
+    tokenOutput.close();
+    if (!success || !tokensWritten) {
+      SD.remove(getTokensPath().c_str());
+    }
+  }
 
-  SD.remove(tmpHtmlPath.c_str());
   if (!success) {
+    // The reader still has the checkpoint file open
+    reader.reset();
+
+    if (cancelled) {
+      // Everything up to the last checkpoint stays on SD for the next build to resume from
+      Serial.printf("[%lu] [SCT] Build cancelled after page %d\n", millis(), pageCount - 1);
+      stopPageWriter();
+      outputFile.close();
+      closeResumeFile();
+      partial = false;
+      pageCount = 0;
+      pageCache.clear();
+      pageOffsets.clear();
+      return false;
+    }
+
+    if (replaying) {
+      // Parsing the chapter records a fresh one
+      Serial.printf("[%lu] [SCT] Failed to build pages from token stream, parsing chapter instead\n", millis());
+      SD.remove(getTokensPath().c_str());
+      clearCache();
+      return persistPageDataToSD(fontId, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+                                 extraParagraphSpacing, continueFn);
+    }
+
     Serial.printf("[%lu] [SCT] Failed to parse XML and build pages\n", millis());
+    clearCache();
     return false;
   }
 
-  writeCacheMetadata(fontId, lineCompression, marginTop, marginRight, marginBottom, marginLeft, extraParagraphSpacing);
+  if (!finishCacheFile()) {
+    Serial.printf("[%lu] [SCT] Failed to write section file\n", millis());
+    clearCache();
+    return false;
+  }
 
+  // Complete, so the journal has nothing left to resume
+  closeResumeFile();
+  SD.remove(getResumePath().c_str());
+  epub->recordCacheUse(layoutDir, true);
+  partial = false;
   return true;
 }
 
-std::unique_ptr<Page> Section::loadPageFromSD() const {
-  const auto filePath = "/sd" + cachePath + "/page_" + std::to_string(currentPage) + ".bin";
-  if (!SD.exists(filePath.c_str() + 3)) {
-    Serial.printf("[%lu] [SCT] Page file does not exist: %s\n", millis(), filePath.c_str());
+std::unique_ptr<PageView> Section::loadPageFromSD(const int page) const {
+  if ((partial && !outputFile.is_open()) || page < 0 || page >= static_cast<int>(pageOffsets.size())) {
+    Serial.printf("[%lu] [SCT] Page %d is not in section file: %s\n", millis(), page, filePath.c_str());
     return nullptr;
   }
 
-  std::ifstream inputFile(filePath);
-  auto page = Page::deserialize(inputFile);
-  inputFile.close();
-  return page;
+  if (!partial) {
+    // Opened per read, so a section that is only being shown doesn't hold an SD handle. The offset table is in memory.
+    std::ifstream inputFile("/sd" + filePath);
+    return readPage(inputFile, page);
+  }
+
+  // Pages of a section still being built are read back through the file being written, a second handle on it
+  // wouldn't see data that hasn't been closed out yet. Writing carries on from where it was once the pages still
+  // queued have been written.
+  if (pageStream) {
+    pageStream->flush();
+  }
+  const auto writePosition = outputFile.tellp();
+  auto view = readPage(outputFile, page);
+  outputFile.clear();
+  outputFile.seekp(writePosition);
+  return view;
+}
+
+std::unique_ptr<PageView> Section::readPage(std::istream& file, const int page) const {
+  // Pages are stored back to back, each one ends where the next starts
+  const uint32_t end = page + 1 < static_cast<int>(pageOffsets.size()) ? pageOffsets[page + 1] : pagesEnd;
+  if (end <= pageOffsets[page]) {
+    Serial.printf("[%lu] [SCT] Page %d has no data\n", millis(), page);
+    return nullptr;
+  }
+  const uint32_t size = end - pageOffsets[page];
+
+  // The whole page goes into one buffer and is rendered from there
+  std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[size]);
+  if (!buffer) {
+    Serial.printf("[%lu] [SCT] Failed to allocate %u bytes for page\n", millis(), size);
+    return nullptr;
+  }
+  file.clear();
+  file.seekg(pageOffsets[page]);
+  file.read(reinterpret_cast<char*>(buffer.get()), size);
+  if (!file) {
+    Serial.printf("[%lu] [SCT] Failed to read page %d\n", millis(), page);
+    return nullptr;
+  }
+  return PageView::create(std::move(buffer), size);
+}
+
+std::shared_ptr<PageView> Section::getPage(const int page) {
+  for (const auto& cached : pageCache) {
+    if (cached.page == page) {
+      return cached.view;
+    }
+  }
+
+  std::shared_ptr<PageView> view = loadPageFromSD(page);
+  if (!view) {
+    return nullptr;
+  }
+
+  // Room for the current page and its neighbours either side, fewer when heap is short
+  const uint32_t freeHeap = ESP.getFreeHeap();
+  const size_t capacity = freeHeap > PAGE_CACHE_ROOMY_HEAP ? MAX_CACHED_PAGES : freeHeap > PAGE_CACHE_MIN_HEAP ? 3 : 1;
+
+  // Evict the pages furthest from the current one, they are the least likely to be turned to next
+  while (!pageCache.empty() && pageCache.size() >= capacity) {
+    auto furthest = pageCache.begin();
+    for (auto it = pageCache.begin(); it != pageCache.end(); ++it) {
+      if (abs(it->page - currentPage) > abs(furthest->page - currentPage)) {
+        furthest = it;
+      }
+    }
+    pageCache.erase(furthest);
+  }
+
+  pageCache.push_back({page, view});
+  return view;
+}
+
+void Section::prefetchPage(const int page) {
+  if (page < 0 || page >= pageCount) {
+    return;
+  }
+  getPage(page);
 }
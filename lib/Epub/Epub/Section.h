@@ -1,36 +1,93 @@
 #pragma once
+#include <cstdio>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "Epub.h"
+#include "WriteBehindBuffer.h"
 
 class Page;
+class PageView;
 class GfxRenderer;
+struct ParseCheckpoint;
 
 class Section {
   std::shared_ptr<Epub> epub;
   const int spineIndex;
   GfxRenderer& renderer;
-  std::string cachePath;
+  // One directory per set of layout parameters, so switching between layouts keeps the sections built for each
+  std::string layoutDir;
+  // Single container file: header, page data appended as pages are built, then the page offset table
+  std::string filePath;
+  // Written to while the section is being built, and read from for pages already built. Once it is complete pages are
+  // read through a handle opened for each read.
+  mutable std::fstream outputFile;
+  // Pages are written through this while the section is being built, so parsing carries on while they go to SD
+  std::unique_ptr<WriteBehindBuffer> pageWriter;
+  std::unique_ptr<std::ostream> pageStream;
+  bool partial = false;
+  std::vector<uint32_t> pageOffsets;
+  // End of the last page written, where the offset table goes once the section is complete
+  uint32_t pagesEnd = 0;
+  // Decoded pages around the current one, so flipping back and forth doesn't go to SD
+  struct CachedPage {
+    int page;
+    std::shared_ptr<PageView> view;
+  };
+  std::vector<CachedPage> pageCache;
+  // Journal of parse checkpoints while the section is being built, with the page offsets added since the previous one,
+  // so an interrupted build can carry on from the last checkpoint
+  FILE* resumeFile = nullptr;
+  size_t journaledPages = 0;
 
-  void writeCacheMetadata(int fontId, float lineCompression, int marginTop, int marginRight, int marginBottom,
-                          int marginLeft, bool extraParagraphSpacing) const;
+  void selectLayout(int fontId, float lineCompression, int marginTop, int marginRight, int marginBottom, int marginLeft,
+                    bool extraParagraphSpacing);
+  std::string getCheckpointPath() const;
+  std::string getTokensPath() const;
+  bool openTokenStream(std::ifstream& file) const;
+  std::string getResumePath() const;
+  bool headerMatches(std::istream& file, int fontId, float lineCompression, int marginTop, int marginRight,
+                     int marginBottom, int marginLeft, bool extraParagraphSpacing) const;
+  bool loadResumePoint(int fontId, float lineCompression, int marginTop, int marginRight, int marginBottom,
+                       int marginLeft, bool extraParagraphSpacing, ParseCheckpoint* checkpoint, uint32_t* fileSize,
+                       long* journalSize);
+  void onCheckpoint(const ParseCheckpoint& checkpoint);
+  void closeResumeFile();
+  void startPageWriter();
+  bool stopPageWriter();
+  void writeCacheHeader(int fontId, float lineCompression, int marginTop, int marginRight, int marginBottom,
+                        int marginLeft, bool extraParagraphSpacing);
+  bool finishCacheFile();
   void onPageComplete(std::unique_ptr<Page> page);
+  std::unique_ptr<PageView> loadPageFromSD(int page) const;
+  std::unique_ptr<PageView> readPage(std::istream& file, int page) const;
 
  public:
   int pageCount = 0;
   int currentPage = 0;
 
   explicit Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer)
-      : epub(epub),
-        spineIndex(spineIndex),
-        renderer(renderer),
-        cachePath(epub->getCachePath() + "/" + std::to_string(spineIndex)) {}
+      : epub(epub), spineIndex(spineIndex), renderer(renderer) {}
   ~Section() = default;
   bool loadCacheMetadata(int fontId, float lineCompression, int marginTop, int marginRight, int marginBottom,
                          int marginLeft, bool extraParagraphSpacing);
   void setupCacheDir() const;
-  bool clearCache() const;
+  bool clearCache();
+  // Directory of the section's layout variant, set by loadCacheMetadata() or persistPageDataToSD()
+  const std::string& getLayoutDir() const { return layoutDir; }
+  // True while the section is being built, pages can already be read and pageCount grows as they are written
+  bool isPartial() const { return partial; }
+  // Parses the chapter, or lays it out from its token stream if an earlier build recorded one. continueFn is polled
+  // as it goes, returning false abandons the build and leaves what was checkpointed for the next one to resume from.
   bool persistPageDataToSD(int fontId, float lineCompression, int marginTop, int marginRight, int marginBottom,
-                           int marginLeft, bool extraParagraphSpacing);
-  std::unique_ptr<Page> loadPageFromSD() const;
+                           int marginLeft, bool extraParagraphSpacing,
+                           const std::function<bool()>& continueFn = nullptr);
+  // Page from the page cache, read from SD on a miss
+  std::shared_ptr<PageView> getPage(int page);
+  // Current page from the page cache, read from SD on a miss
+  std::shared_ptr<PageView> getCurrentPage() { return getPage(currentPage); }
+  // Loads a page into the cache ahead of it being shown, out of range pages are ignored
+  void prefetchPage(int page);
 };
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Bump allocator for short lived strings, storage is handed out from fixed size blocks so existing views stay valid
+// as it grows and everything is returned in one go on release()
+class StringArena {
+  static constexpr size_t BLOCK_SIZE = 4096;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  std::vector<std::unique_ptr<char[]>> largeBlocks;
+  size_t blockUsed = BLOCK_SIZE;
+  size_t bytesUsed = 0;
+
+ public:
+  std::string_view store(const char* s, const size_t len) {
+    if (len == 0) {
+      return {};
+    }
+
+    char* dest;
+    if (len > BLOCK_SIZE / 4) {
+      // Oversized strings get a block of their own, current block stays open for the next small string
+      largeBlocks.emplace_back(new char[len]);
+      dest = largeBlocks.back().get();
+    } else {
+      if (blockUsed + len > BLOCK_SIZE) {
+        blocks.emplace_back(new char[BLOCK_SIZE]);
+        blockUsed = 0;
+      }
+      dest = blocks.back().get() + blockUsed;
+      blockUsed += len;
+    }
+
+    memcpy(dest, s, len);
+    bytesUsed += len;
+    return {dest, len};
+  }
+
+  std::string_view store(const char* s) { return store(s, strlen(s)); }
+
+  size_t size() const { return bytesUsed; }
+
+  void release() {
+    std::vector<std::unique_ptr<char[]>>().swap(blocks);
+    std::vector<std::unique_ptr<char[]>>().swap(largeBlocks);
+    blockUsed = BLOCK_SIZE;
+    bytesUsed = 0;
+  }
+};
@@ -0,0 +1,47 @@
+#include "StringTable.h"
+
+#include <Serialization.h>
+
+#include <cstring>
+
+uint32_t StringTable::intern(const std::string& s) {
+  const auto existing = ids.find(std::string_view(s));
+  if (existing != ids.end()) {
+    return existing->second;
+  }
+
+  const auto id = static_cast<uint32_t>(strings.size());
+  const auto stored = arena.store(s.c_str(), s.size() + 1).substr(0, s.size());
+  strings.push_back(stored);
+  ids.emplace(stored, id);
+  return id;
+}
+
+void StringTable::serialize(std::ostream& os) const {
+  serialization::writeVarint(os, strings.size());
+  for (const auto& s : strings) {
+    os.write(s.data(), s.size());
+    os.put('\0');
+  }
+}
+
+const uint8_t* StringTable::view(const uint8_t* p, const uint8_t* end) {
+  strings.clear();
+
+  uint32_t count;
+  if (!serialization::readVarint(p, end, count) || count > static_cast<size_t>(end - p)) {
+    return nullptr;
+  }
+
+  strings.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    const auto* terminator = static_cast<const uint8_t*>(memchr(p, '\0', end - p));
+    if (!terminator) {
+      strings.clear();
+      return nullptr;
+    }
+    strings.emplace_back(reinterpret_cast<const char*>(p), terminator - p);
+    p = terminator + 1;
+  }
+  return p;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "StringArena.h"
+
+// Deduplicated words of a single page, the page's lines refer to them by their index in the table. Every page carries
+// its own table so only the words of the pages being built or shown are ever in memory, however long the chapter.
+// Every string is stored with a trailing null so it can be drawn straight from the table.
+class StringTable {
+  // Backing storage while the table is being built, views stay valid as it grows
+  StringArena arena;
+  std::vector<std::string_view> strings;
+  std::unordered_map<std::string_view, uint32_t> ids;
+
+ public:
+  uint32_t intern(const std::string& s);
+  bool contains(const uint32_t id) const { return id < strings.size(); }
+  std::string_view get(const uint32_t id) const { return strings[id]; }
+  const char* c_str(const uint32_t id) const { return strings[id].data(); }
+  size_t size() const { return strings.size(); }
+
+  void serialize(std::ostream& os) const;
+  // Points the table at one written by serialize() into a buffer that outlives it, nothing is copied. Returns the end
+  // of the table or nullptr if it is malformed.
+  const uint8_t* view(const uint8_t* p, const uint8_t* end);
+};
@@ -0,0 +1,161 @@
+#include "WriteBehindBuffer.h"
+
+#include <HardwareSerial.h>
+
+#include <new>
+
+WriteBehindBuffer::WriteBehindBuffer(std::ostream& sink)
+    : sink(sink), batchPosition(static_cast<uint32_t>(sink.tellp())) {
+  for (auto& batch : batches) {
+    batch.data.reset(new (std::nothrow) char[BATCH_SIZE]);
+    if (!batch.data) {
+      Serial.printf("[%lu] [WBB] Not enough memory for batches, writing directly\n", millis());
+      for (auto& allocated : batches) {
+        allocated.data.reset();
+      }
+      return;
+    }
+  }
+
+  fullBatches = xQueueCreate(BATCH_COUNT, sizeof(Batch*));
+  freeBatches = xQueueCreate(BATCH_COUNT, sizeof(Batch*));
+  writerRunning = true;
+  if (!fullBatches || !freeBatches ||
+      xTaskCreate(&WriteBehindBuffer::writerTaskTrampoline, "WriteBehindTask",
+                  4096,              // Stack size
+                  this,              // Parameters
+                  1,                 // Priority
+                  &writerTaskHandle  // Task handle
+                  ) != pdPASS) {
+    // Batches are still used to gather small writes, they are just written by the producer
+    Serial.printf("[%lu] [WBB] Could not start writer task, writing batches directly\n", millis());
+    writerRunning = false;
+    writerTaskHandle = nullptr;
+    for (size_t i = 1; i < BATCH_COUNT; i++) {
+      batches[i].data.reset();
+    }
+  }
+
+  current = &batches[0];
+  for (size_t i = 1; i < BATCH_COUNT && writerRunning; i++) {
+    Batch* batch = &batches[i];
+    xQueueSend(freeBatches, &batch, portMAX_DELAY);
+  }
+  startBatch();
+}
+
+WriteBehindBuffer::~WriteBehindBuffer() {
+  sync();
+
+  if (writerTaskHandle) {
+    // The task may be in the middle of a write to sink, so it finishes up and deletes itself
+    Batch* stop = nullptr;
+    xQueueSend(fullBatches, &stop, portMAX_DELAY);
+    while (writerRunning) {
+      vTaskDelay(1);
+    }
+  }
+  if (fullBatches) {
+    vQueueDelete(fullBatches);
+  }
+  if (freeBatches) {
+    vQueueDelete(freeBatches);
+  }
+}
+
+void WriteBehindBuffer::writerTaskTrampoline(void* param) {
+  auto* self = static_cast<WriteBehindBuffer*>(param);
+  self->writerTaskLoop();
+}
+
+void WriteBehindBuffer::writerTaskLoop() {
+  while (true) {
+    Batch* batch = nullptr;
+    xQueueReceive(fullBatches, &batch, portMAX_DELAY);
+    if (!batch) {
+      break;
+    }
+
+    sink.write(batch->data.get(), static_cast<std::streamsize>(batch->size));
+    if (!sink) {
+      writeFailed = true;
+    }
+    batch->size = 0;
+    xQueueSend(freeBatches, &batch, portMAX_DELAY);
+  }
+
+  writerRunning = false;
+  vTaskDelete(nullptr);
+}
+
+void WriteBehindBuffer::startBatch() {
+  // Short of a full batch when the position isn't aligned yet, so the batches after it are
+  const size_t limit = BATCH_SIZE - batchPosition % BATCH_SIZE;
+  setp(current->data.get(), current->data.get() + limit);
+}
+
+void WriteBehindBuffer::submitBatch() {
+  const auto size = static_cast<size_t>(pptr() - pbase());
+  if (size == 0) {
+    return;
+  }
+
+  current->size = size;
+  if (writerRunning) {
+    xQueueSend(fullBatches, &current, portMAX_DELAY);
+    // Blocks while every batch is waiting to be written
+    xQueueReceive(freeBatches, &current, portMAX_DELAY);
+  } else {
+    sink.write(current->data.get(), static_cast<std::streamsize>(size));
+    if (!sink) {
+      writeFailed = true;
+    }
+    current->size = 0;
+  }
+  batchPosition += static_cast<uint32_t>(size);
+  startBatch();
+}
+
+void WriteBehindBuffer::waitUntilWritten() const {
+  if (!writerRunning) {
+    return;
+  }
+  // Every batch but the one being filled is back in the free queue once it has been written
+  while (uxQueueMessagesWaiting(freeBatches) < BATCH_COUNT - 1) {
+    vTaskDelay(1);
+  }
+}
+
+WriteBehindBuffer::int_type WriteBehindBuffer::overflow(const int_type ch) {
+  if (!current) {
+    if (ch != traits_type::eof()) {
+      sink.put(static_cast<char>(ch));
+      batchPosition++;
+    }
+    return sink ? traits_type::not_eof(ch) : traits_type::eof();
+  }
+
+  submitBatch();
+  if (ch != traits_type::eof()) {
+    *pptr() = static_cast<char>(ch);
+    pbump(1);
+  }
+  return writeFailed ? traits_type::eof() : traits_type::not_eof(ch);
+}
+
+std::streamsize WriteBehindBuffer::xsputn(const char* s, const std::streamsize n) {
+  if (!current) {
+    sink.write(s, n);
+    batchPosition += static_cast<uint32_t>(n);
+    return sink ? n : 0;
+  }
+  return std::streambuf::xsputn(s, n);
+}
+
+int WriteBehindBuffer::sync() {
+  if (current) {
+    submitBatch();
+    waitUntilWritten();
+  }
+  return writeFailed || !sink ? -1 : 0;
+}
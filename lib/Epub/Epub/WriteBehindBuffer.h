@@ -0,0 +1,62 @@
+#pragma once
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+/**
+ * Stream buffer that collects what is written to it into batches and leaves writing them to sink to a task of its own,
+ * so whoever is producing the data carries on while the previous batch goes to SD.
+ *
+ * Batches end on BATCH_SIZE boundaries of the sink position, so all but the ones either side of a sync() (or the first,
+ * if sink starts mid-sector) are whole 512 byte sectors that FAT writes without reading back a partial one. They are
+ * smaller than a FAT32 cluster (16-32KB), as BATCH_COUNT of that size wouldn't fit in the heap alongside a section
+ * build. There is a fixed pool of BATCH_COUNT of them, writing blocks while they are all full, which bounds the heap
+ * used however far ahead the producer gets. sync() (flush() on the stream) returns once everything written has reached
+ * sink, sink must not be touched otherwise while the buffer exists. Falls back to writing straight to sink if the
+ * writer task or the batches can't be allocated.
+ */
+class WriteBehindBuffer final : public std::streambuf {
+ public:
+  // A multiple of the 512 byte sector size
+  static constexpr size_t BATCH_SIZE = 4096;
+  static constexpr size_t BATCH_COUNT = 3;
+
+ private:
+  struct Batch {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+
+  std::ostream& sink;
+  Batch batches[BATCH_COUNT];
+  Batch* current = nullptr;
+  // Sink position of the start of the current batch
+  uint32_t batchPosition = 0;
+  // Batches waiting to be written, and written batches ready to be filled again
+  QueueHandle_t fullBatches = nullptr;
+  QueueHandle_t freeBatches = nullptr;
+  TaskHandle_t writerTaskHandle = nullptr;
+  volatile bool writerRunning = false;
+  volatile bool writeFailed = false;
+
+  static void writerTaskTrampoline(void* param);
+  void writerTaskLoop();
+  void startBatch();
+  void submitBatch();
+  void waitUntilWritten() const;
+
+ protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+  int sync() override;
+
+ public:
+  explicit WriteBehindBuffer(std::ostream& sink);
+  ~WriteBehindBuffer() override;
+  // Sink position the next byte written will end up at
+  uint32_t position() const { return batchPosition + static_cast<uint32_t>(pptr() - pbase()); }
+};
@@ -1,8 +1,13 @@
 #include "TextBlock.h"
 
 #include <GfxRenderer.h>
+#include <HardwareSerial.h>
 #include <Serialization.h>
 
+#include <vector>
+
+#include "Epub/StringTable.h"
+
 void TextBlock::render(const GfxRenderer& renderer, const int fontId, const int x, const int y) const {
   auto wordIt = words.begin();
   auto wordStylesIt = wordStyles.begin();
@@ -17,50 +22,118 @@ void TextBlock::render(const GfxRenderer& renderer, const int fontId, const int
   }
 }
 
-void TextBlock::serialize(std::ostream& os) const {
-  // words
-  const uint32_t wc = words.size();
-  serialization::writePod(os, wc);
-  for (const auto& w : words) serialization::writeString(os, w);
+void TextBlock::serialize(std::ostream& os, StringTable& strings) const {
+  serialization::writePod(os, style);
 
-  // wordXpos
-  const uint32_t xc = wordXpos.size();
-  serialization::writePod(os, xc);
-  for (auto x : wordXpos) serialization::writePod(os, x);
+  // words, as indexes into the page's string table
+  serialization::writeVarint(os, words.size());
+  for (const auto& w : words) serialization::writeVarint(os, strings.intern(w));
 
-  // wordStyles
-  const uint32_t sc = wordStyles.size();
-  serialization::writePod(os, sc);
-  for (auto s : wordStyles) serialization::writePod(os, s);
+  // wordXpos, each relative to the previous word
+  int32_t previousX = 0;
+  for (const auto x : wordXpos) {
+    serialization::writeSignedVarint(os, x - previousX);
+    previousX = x;
+  }
 
-  // style
-  serialization::writePod(os, style);
+  // wordStyles, as runs of the same style
+  std::vector<std::pair<EpdFontStyle, uint32_t>> styleRuns;
+  for (const auto s : wordStyles) {
+    if (!styleRuns.empty() && styleRuns.back().first == s) {
+      styleRuns.back().second++;
+    } else {
+      styleRuns.emplace_back(s, 1);
+    }
+  }
+  serialization::writeVarint(os, styleRuns.size());
+  for (const auto& run : styleRuns) {
+    serialization::writePod(os, static_cast<uint8_t>(run.first));
+    serialization::writeVarint(os, run.second);
+  }
 }
 
-std::unique_ptr<TextBlock> TextBlock::deserialize(std::istream& is) {
-  uint32_t wc, xc, sc;
-  std::list<std::string> words;
-  std::list<uint16_t> wordXpos;
-  std::list<EpdFontStyle> wordStyles;
-  BLOCK_STYLE style;
+const uint8_t* TextBlock::skipSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings) {
+  if (p >= end || *p > RIGHT_ALIGN) {
+    return nullptr;
+  }
+  p++;
 
-  // words
-  serialization::readPod(is, wc);
-  words.resize(wc);
-  for (auto& w : words) serialization::readString(is, w);
+  uint32_t wc;
+  if (!serialization::readVarint(p, end, wc)) {
+    return nullptr;
+  }
 
-  // wordXpos
-  serialization::readPod(is, xc);
-  wordXpos.resize(xc);
-  for (auto& x : wordXpos) serialization::readPod(is, x);
+  for (uint32_t i = 0; i < wc; i++) {
+    uint32_t id;
+    if (!serialization::readVarint(p, end, id) || !strings.contains(id)) {
+      Serial.printf("[%lu] [TXB] Invalid word in serialized block\n", millis());
+      return nullptr;
+    }
+  }
 
-  // wordStyles
-  serialization::readPod(is, sc);
-  wordStyles.resize(sc);
-  for (auto& s : wordStyles) serialization::readPod(is, s);
+  for (uint32_t i = 0; i < wc; i++) {
+    int32_t delta;
+    if (!serialization::readSignedVarint(p, end, delta)) {
+      return nullptr;
+    }
+  }
 
-  // style
-  serialization::readPod(is, style);
+  uint32_t runCount;
+  uint32_t styledWords = 0;
+  if (!serialization::readVarint(p, end, runCount)) {
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < runCount; i++) {
+    uint32_t runLength;
+    if (p >= end || *p > BOLD_ITALIC) {
+      return nullptr;
+    }
+    p++;
+    if (!serialization::readVarint(p, end, runLength)) {
+      return nullptr;
+    }
+    styledWords += runLength;
+  }
+
+  return styledWords == wc ? p : nullptr;
+}
+
+void TextBlock::renderSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings,
+                                 const GfxRenderer& renderer, const int fontId, const int x, const int y) {
+  // Words, positions and styles are stored as three runs one after another, walk them side by side
+  p++;  // style
+  uint32_t wc;
+  serialization::readVarint(p, end, wc);
 
-  return std::unique_ptr<TextBlock>(new TextBlock(std::move(words), std::move(wordXpos), std::move(wordStyles), style));
+  const uint8_t* idIt = p;
+  const uint8_t* xposIt = p;
+  for (uint32_t i = 0; i < wc; i++) {
+    uint32_t id;
+    serialization::readVarint(xposIt, end, id);
+  }
+  const uint8_t* styleIt = xposIt;
+  for (uint32_t i = 0; i < wc; i++) {
+    int32_t delta;
+    serialization::readSignedVarint(styleIt, end, delta);
+  }
+  uint32_t runCount;
+  serialization::readVarint(styleIt, end, runCount);
+
+  int32_t wordX = 0;
+  uint32_t runRemaining = 0;
+  auto style = REGULAR;
+  for (uint32_t i = 0; i < wc; i++) {
+    uint32_t id;
+    int32_t delta;
+    serialization::readVarint(idIt, end, id);
+    serialization::readSignedVarint(xposIt, end, delta);
+    wordX += delta;
+    while (runRemaining == 0) {
+      style = static_cast<EpdFontStyle>(*styleIt++);
+      serialization::readVarint(styleIt, end, runRemaining);
+    }
+    runRemaining--;
+
+    renderer.drawText(fontId, wordX + x, y, strings.c_str(id), true, style);
+  }
 }
@@ -7,6 +7,8 @@
 
 #include "Block.h"
 
+class StringTable;
+
 // represents a block of words in the html document
 class TextBlock final : public Block {
  public:
@@ -35,6 +37,9 @@ class TextBlock final : public Block {
   // given a renderer works out where to break the words into lines
   void render(const GfxRenderer& renderer, int fontId, int x, int y) const;
   BlockType getType() override { return TEXT_BLOCK; }
-  void serialize(std::ostream& os) const;
-  static std::unique_ptr<TextBlock> deserialize(std::istream& is);
+  void serialize(std::ostream& os, StringTable& strings) const;
+  // Works over a serialized block in place, skip returns the end of the block or nullptr if it is malformed
+  static const uint8_t* skipSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings);
+  static void renderSerialized(const uint8_t* p, const uint8_t* end, const StringTable& strings,
+                               const GfxRenderer& renderer, int fontId, int x, int y);
 };
@@ -2,7 +2,12 @@
 
 #include <GfxRenderer.h>
 #include <HardwareSerial.h>
+#include <Serialization.h>
+#include <ZipEntryReader.h>
 #include <expat.h>
+#include <strings.h>
+
+#include <algorithm>
 
 #include "../Page.h"
 #include "../htmlEntities.h"
@@ -25,6 +30,17 @@ constexpr int NUM_IMAGE_TAGS = sizeof(IMAGE_TAGS) / sizeof(IMAGE_TAGS[0]);
 const char* SKIP_TAGS[] = {"head", "table"};
 constexpr int NUM_SKIP_TAGS = sizeof(SKIP_TAGS) / sizeof(SKIP_TAGS[0]);
 
+// Stands in for the chapter's own doctype when resuming part way through, an external subset keeps expat lenient about
+// undeclared HTML entities like &nbsp; the same way it is for chapters that declare one
+const char RESUME_DOCTYPE[] =
+    "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\" \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">";
+
+// Token stream: one varint per token. Odd values start a text block, with its style in the bits above. Even values are
+// a word, with its font style in bits 1-2 and its length above, followed by the word itself. TOKEN_END ends the stream.
+constexpr uint32_t TOKEN_END = 0xFF << 1 | 1;
+// Tokens laid out between polls of continueFn, roughly the work of a chunk of parsed input
+constexpr uint32_t TOKENS_PER_POLL = 256;
+
 bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
 
 // given the start and end of a tag, check to see if it matches a known tag
@@ -39,22 +55,111 @@ bool matches(const char* tag_name, const char* possible_tags[], const int possib
 
 // start a new text block if needed
 void ChapterHtmlSlimParser::startNewTextBlock(const TextBlock::BLOCK_STYLE style) {
+  if (tokenSink) {
+    serialization::writeVarint(*tokenSink, static_cast<uint32_t>(style) << 1 | 1);
+  }
+
   if (currentTextBlock) {
     // already have a text block running and it is empty - just reuse it
     if (currentTextBlock->isEmpty()) {
       currentTextBlock->setStyle(style);
+      recordBlockStart(style);
       return;
     }
 
     makePages();
+    // Lines skipped on resume all belong to the block it resumed in
+    linesToSkip = 0;
   }
   currentTextBlock.reset(new ParsedText(style, extraParagraphSpacing));
+  recordBlockStart(style);
+}
+
+void ChapterHtmlSlimParser::recordBlockStart(const TextBlock::BLOCK_STYLE style) {
+  // Rewinding to the event that reuses an empty block is the same as rewinding to the one that started it
+  blockStart.inputOffset = static_cast<uint32_t>((xmlParser ? XML_GetCurrentByteIndex(xmlParser) : 0) + inputBase);
+  blockStart.blockStyle = style;
+  blockStart.skipUntilDepth = skipUntilDepth;
+  blockStart.boldUntilDepth = boldUntilDepth;
+  blockStart.italicUntilDepth = italicUntilDepth;
+  blockStart.elementPath.assign(elementPath, 0, eventPathLength);
+  blockStart.linesToSkip = 0;
+  blockStart.encoding = encoding;
+  blockResumable = partWordBufferIndex == 0;
+  blockLinesAdded = 0;
+}
+
+void ChapterHtmlSlimParser::resumeFrom(const ParseCheckpoint& checkpoint) {
+  resuming = true;
+  inputBase = checkpoint.inputOffset;
+  skipUntilDepth = checkpoint.skipUntilDepth;
+  boldUntilDepth = checkpoint.boldUntilDepth;
+  italicUntilDepth = checkpoint.italicUntilDepth;
+  elementPath = checkpoint.elementPath;
+  depth = static_cast<int>(std::count(elementPath.begin(), elementPath.end(), '/'));
+  linesToSkip = checkpoint.linesToSkip;
+  encoding = checkpoint.encoding;
+  blockStart = checkpoint;
+}
+
+// Opens the elements that were open at the checkpoint so the rest of the chapter is well formed to expat. No handlers
+// are set yet, so the state restored by resumeFrom() is left alone.
+bool ChapterHtmlSlimParser::replayElementPath() {
+  // Checkpoints outside the root element are at the very start of the chapter, which is parsed as is
+  if (elementPath.empty()) {
+    return true;
+  }
+
+  // Expat only takes the encoding from a declaration at the very start, so the chapter's own is replayed ahead of the
+  // doctype or the rest of a non UTF-8 chapter would be decoded as UTF-8
+  std::string prefix;
+  if (!encoding.empty()) {
+    prefix = "<?xml version=\"1.0\" encoding=\"" + encoding + "\"?>";
+  }
+  prefix += RESUME_DOCTYPE;
+  size_t start = 0;
+  while (start < elementPath.size()) {
+    size_t end = elementPath.find('/', start + 1);
+    if (end == std::string::npos) {
+      end = elementPath.size();
+    }
+    prefix += '<';
+    prefix.append(elementPath, start + 1, end - start - 1);
+    prefix += '>';
+    start = end;
+  }
+
+  if (XML_Parse(xmlParser, prefix.data(), static_cast<int>(prefix.size()), XML_FALSE) == XML_STATUS_ERROR) {
+    Serial.printf("[%lu] [EHP] Could not restore element path %s: %s\n", millis(), elementPath.c_str(),
+                  XML_ErrorString(XML_GetErrorCode(xmlParser)));
+    return false;
+  }
+  inputBase -= static_cast<int64_t>(prefix.size());
+  return true;
+}
+
+void XMLCALL ChapterHtmlSlimParser::xmlDeclaration(void* userData, const XML_Char* version, const XML_Char* encoding,
+                                                   int standalone) {
+  auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
+  (void)version;
+  (void)standalone;
+  if (!encoding) {
+    return;
+  }
+  self->encoding = encoding;
+  if (strncasecmp(encoding, "UTF-16", 6) == 0) {
+    self->encodingReplayable = false;
+  }
 }
 
 void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
   auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
   (void)atts;
 
+  self->eventPathLength = self->elementPath.size();
+  self->elementPath += '/';
+  self->elementPath += name;
+
   // Middle of skip
   if (self->skipUntilDepth < self->depth) {
     self->depth += 1;
@@ -126,9 +231,7 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
     if (isWhitespace(s[i])) {
       // Currently looking at whitespace, if there's anything in the partWordBuffer, flush it
       if (self->partWordBufferIndex > 0) {
-        self->partWordBuffer[self->partWordBufferIndex] = '\0';
-        self->currentTextBlock->addWord(std::move(replaceHtmlEntities(self->partWordBuffer)), fontStyle);
-        self->partWordBufferIndex = 0;
+        self->flushPartWord(fontStyle);
       }
       // Skip the whitespace char
       continue;
@@ -136,23 +239,40 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
 
     // If we're about to run out of space, then cut the word off and start a new one
     if (self->partWordBufferIndex >= MAX_WORD_SIZE) {
-      self->partWordBuffer[self->partWordBufferIndex] = '\0';
-      self->currentTextBlock->addWord(std::move(replaceHtmlEntities(self->partWordBuffer)), fontStyle);
-      self->partWordBufferIndex = 0;
+      self->flushPartWord(fontStyle);
     }
 
     self->partWordBuffer[self->partWordBufferIndex++] = s[i];
   }
+}
+
+void ChapterHtmlSlimParser::flushPartWord(const EpdFontStyle fontStyle) {
+  partWordBuffer[partWordBufferIndex] = '\0';
+  addWord(replaceHtmlEntities(partWordBuffer), fontStyle);
+  partWordBufferIndex = 0;
+}
+
+void ChapterHtmlSlimParser::addWord(std::string word, const EpdFontStyle fontStyle) {
+  if (tokenSink) {
+    serialization::writeVarint(*tokenSink, static_cast<uint32_t>(word.size()) << 3 | fontStyle << 1);
+    tokenSink->write(word.data(), static_cast<std::streamsize>(word.size()));
+  }
+  currentTextBlock->addWord(std::move(word), fontStyle);
+  layoutLongTextBlock();
+}
 
+void ChapterHtmlSlimParser::layoutLongTextBlock() {
   // If we have > 750 words buffered up, perform the layout and consume out all but the last line
   // There should be enough here to build out 1-2 full pages and doing this will free up a lot of
   // memory.
   // Spotted when reading Intermezzo, there are some really long text blocks in there.
-  if (self->currentTextBlock->size() > 750) {
+  // Checked after every word rather than per chunk of character data, so the split doesn't depend on how the input was
+  // chunked and a resumed parse or a token stream replay lays the block out the same way.
+  if (currentTextBlock->size() > 750) {
     Serial.printf("[%lu] [EHP] Text block too long, splitting into multiple pages\n", millis());
-    self->currentTextBlock->layoutAndExtractLines(
-        self->renderer, self->fontId, self->marginLeft + self->marginRight,
-        [self](const std::shared_ptr<TextBlock>& textBlock) { self->addLineToPage(textBlock); }, false);
+    currentTextBlock->layoutAndExtractLines(
+        renderer, fontId, marginLeft + marginRight,
+        [this](const std::shared_ptr<TextBlock>& textBlock) { addLineToPage(textBlock); }, false);
   }
 }
 
@@ -179,13 +299,15 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
         fontStyle = ITALIC;
       }
 
-      self->partWordBuffer[self->partWordBufferIndex] = '\0';
-      self->currentTextBlock->addWord(std::move(replaceHtmlEntities(self->partWordBuffer)), fontStyle);
-      self->partWordBufferIndex = 0;
+      self->flushPartWord(fontStyle);
     }
   }
 
   self->depth -= 1;
+  const size_t parentPathLength = self->elementPath.rfind('/');
+  if (parentPathLength != std::string::npos) {
+    self->elementPath.resize(parentPathLength);
+  }
 
   // Leaving skip
   if (self->skipUntilDepth == self->depth) {
@@ -204,7 +326,9 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
 }
 
 bool ChapterHtmlSlimParser::parseAndBuildPages() {
-  startNewTextBlock(TextBlock::JUSTIFIED);
+  // JUSTIFIED unless resuming in a block of another style
+  eventPathLength = elementPath.size();
+  startNewTextBlock(static_cast<TextBlock::BLOCK_STYLE>(blockStart.blockStyle));
 
   const XML_Parser parser = XML_ParserCreate(nullptr);
   int done;
@@ -214,17 +338,18 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
     return false;
   }
 
-  FILE* file = fopen(filepath, "r");
-  if (!file) {
-    Serial.printf("[%lu] [EHP] Couldn't open file %s\n", millis(), filepath);
+  XML_SetUserData(parser, this);
+  xmlParser = parser;
+  if (resuming && !replayElementPath()) {
     XML_ParserFree(parser);
+    xmlParser = nullptr;
     return false;
   }
-
-  XML_SetUserData(parser, this);
+  XML_SetXmlDeclHandler(parser, xmlDeclaration);
   XML_SetElementHandler(parser, startElement, endElement);
   XML_SetCharacterDataHandler(parser, characterData);
 
+  bool firstBuffer = true;
   do {
     void* const buf = XML_GetBuffer(parser, 1024);
     if (!buf) {
@@ -233,23 +358,33 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
-      fclose(file);
+      xmlParser = nullptr;
       return false;
     }
 
-    const size_t len = fread(buf, 1, 1024, file);
+    // Inflate straight into the parser's buffer
+    const size_t len = reader->read(static_cast<uint8_t*>(buf), 1024);
 
-    if (ferror(file)) {
+    if (reader->hasFailed()) {
       Serial.printf("[%lu] [EHP] File read error\n", millis());
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
-      fclose(file);
+      xmlParser = nullptr;
       return false;
     }
 
-    done = feof(file);
+    // A byte order mark is all a UTF-16 chapter needs, without a declaration naming the encoding
+    if (firstBuffer && !resuming && len >= 2) {
+      const auto* bytes = static_cast<const uint8_t*>(buf);
+      if ((bytes[0] == 0xFE && bytes[1] == 0xFF) || (bytes[0] == 0xFF && bytes[1] == 0xFE)) {
+        encodingReplayable = false;
+      }
+    }
+    firstBuffer = false;
+
+    done = reader->eof() || len == 0;
 
     if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
       Serial.printf("[%lu] [EHP] Parse error at line %lu:\n%s\n", millis(), XML_GetCurrentLineNumber(parser),
@@ -258,7 +393,17 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
       XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
-      fclose(file);
+      xmlParser = nullptr;
+      return false;
+    }
+
+    if (!done && continueFn && !continueFn()) {
+      Serial.printf("[%lu] [EHP] Parsing cancelled\n", millis());
+      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
+      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
+      XML_SetCharacterDataHandler(parser, nullptr);
+      XML_ParserFree(parser);
+      xmlParser = nullptr;
       return false;
     }
   } while (!done);
@@ -267,8 +412,58 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
   XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
   XML_SetCharacterDataHandler(parser, nullptr);
   XML_ParserFree(parser);
-  fclose(file);
+  xmlParser = nullptr;
+
+  if (tokenSink) {
+    serialization::writeVarint(*tokenSink, TOKEN_END);
+  }
+  finishPages();
+  return true;
+}
+
+bool ChapterHtmlSlimParser::buildPagesFromTokens(std::istream& tokens) {
+  std::string word;
+  uint32_t tokenCount = 0;
+  while (true) {
+    uint32_t token;
+    serialization::readVarint(tokens, token);
+    if (!tokens) {
+      Serial.printf("[%lu] [EHP] Token stream ended early\n", millis());
+      return false;
+    }
+    if (token == TOKEN_END) {
+      break;
+    }
+
+    if (token & 1) {
+      startNewTextBlock(static_cast<TextBlock::BLOCK_STYLE>(token >> 1));
+    } else {
+      const uint32_t length = token >> 3;
+      // Words are cut at MAX_WORD_SIZE before entities are replaced, which never makes them longer
+      if (!currentTextBlock || length > MAX_WORD_SIZE) {
+        Serial.printf("[%lu] [EHP] Token stream is corrupt\n", millis());
+        return false;
+      }
+      word.resize(length);
+      tokens.read(&word[0], length);
+      if (!tokens) {
+        Serial.printf("[%lu] [EHP] Token stream ended early\n", millis());
+        return false;
+      }
+      addWord(word, static_cast<EpdFontStyle>(token >> 1 & 3));
+    }
 
+    if (++tokenCount % TOKENS_PER_POLL == 0 && continueFn && !continueFn()) {
+      Serial.printf("[%lu] [EHP] Building pages from tokens cancelled\n", millis());
+      return false;
+    }
+  }
+
+  finishPages();
+  return true;
+}
+
+void ChapterHtmlSlimParser::finishPages() {
   // Process last page if there is still text
   if (currentTextBlock) {
     makePages();
@@ -276,18 +471,35 @@ bool ChapterHtmlSlimParser::parseAndBuildPages() {
     currentPage.reset();
     currentTextBlock.reset();
   }
-
-  return true;
 }
 
 void ChapterHtmlSlimParser::addLineToPage(std::shared_ptr<TextBlock> line) {
+  const uint32_t lineInBlock = blockLinesAdded++;
+  // Already on pages written before the parse was resumed
+  if (lineInBlock < linesToSkip) {
+    return;
+  }
+
   const int lineHeight = renderer.getLineHeight(fontId) * lineCompression;
   const int pageHeight = GfxRenderer::getScreenHeight() - marginTop - marginBottom;
 
+  // Long blocks are laid out before makePages() has set up the first page
+  if (!currentPage) {
+    currentPage.reset(new Page());
+    currentPageNextY = marginTop;
+  }
+
   if (currentPageNextY + lineHeight > pageHeight) {
     completePageFn(std::move(currentPage));
     currentPage.reset(new Page());
     currentPageNextY = marginTop;
+
+    // The new page starts with this line, so a resumed parse can rebuild it from the start of the block
+    if (checkpointFn && blockResumable && encodingReplayable) {
+      ParseCheckpoint checkpoint = blockStart;
+      checkpoint.linesToSkip = lineInBlock;
+      checkpointFn(checkpoint);
+    }
   }
 
   currentPage->elements.push_back(std::make_shared<PageLine>(line, marginLeft, currentPageNextY));
@@ -4,20 +4,62 @@
 
 #include <climits>
 #include <functional>
+#include <iosfwd>
 #include <memory>
+#include <string>
 
 #include "../ParsedText.h"
 #include "../blocks/TextBlock.h"
 
 class Page;
 class GfxRenderer;
+class ZipEntryReader;
 
 #define MAX_WORD_SIZE 200
 
+// Where an interrupted parse can pick up again: the event that started the text block being laid out when a page was
+// completed, with the elements open and the styling in effect just before it
+struct ParseCheckpoint {
+  // Inflated offset of the event in the chapter
+  uint32_t inputOffset = 0;
+  uint8_t blockStyle = TextBlock::JUSTIFIED;
+  int skipUntilDepth = INT_MAX;
+  int boldUntilDepth = INT_MAX;
+  int italicUntilDepth = INT_MAX;
+  // Names of the open elements, each preceded by a '/'
+  std::string elementPath;
+  // Lines of the block that are already on completed pages
+  uint32_t linesToSkip = 0;
+  // Encoding named by the chapter's XML declaration, empty if it names none
+  std::string encoding;
+};
+
 class ChapterHtmlSlimParser {
-  const char* filepath;
+  // Null when building pages from a token stream
+  ZipEntryReader* reader;
   GfxRenderer& renderer;
   std::function<void(std::unique_ptr<Page>)> completePageFn;
+  // Called between input chunks, parsing is abandoned when it returns false
+  std::function<bool()> continueFn;
+  // Called after a page is completed at a point the parse could be resumed from
+  std::function<void(const ParseCheckpoint&)> checkpointFn;
+  // Receives the layout independent token stream of the chapter as it is parsed
+  std::ostream* tokenSink = nullptr;
+  XML_Parser xmlParser = nullptr;
+  // Added to expat's byte index to get the offset in the chapter, non zero once resumed
+  int64_t inputBase = 0;
+  std::string elementPath;
+  // Length of elementPath before the element currently being started
+  size_t eventPathLength = 0;
+  // Resume point for the current text block, only usable if the block started on a word boundary
+  ParseCheckpoint blockStart;
+  bool blockResumable = true;
+  uint32_t blockLinesAdded = 0;
+  bool resuming = false;
+  std::string encoding;
+  // False for UTF-16 chapters, the replayed prefix is 8 bit so they can only be parsed from the start
+  bool encodingReplayable = true;
+  uint32_t linesToSkip = 0;
   int depth = 0;
   int skipUntilDepth = INT_MAX;
   int boldUntilDepth = INT_MAX;
@@ -38,18 +80,27 @@ class ChapterHtmlSlimParser {
   bool extraParagraphSpacing;
 
   void startNewTextBlock(TextBlock::BLOCK_STYLE style);
+  void recordBlockStart(TextBlock::BLOCK_STYLE style);
+  bool replayElementPath();
+  void addWord(std::string word, EpdFontStyle fontStyle);
+  void flushPartWord(EpdFontStyle fontStyle);
+  void layoutLongTextBlock();
   void makePages();
+  void finishPages();
   // XML callbacks
   static void XMLCALL startElement(void* userData, const XML_Char* name, const XML_Char** atts);
   static void XMLCALL characterData(void* userData, const XML_Char* s, int len);
   static void XMLCALL endElement(void* userData, const XML_Char* name);
+  static void XMLCALL xmlDeclaration(void* userData, const XML_Char* version, const XML_Char* encoding,
+                                     int standalone);
 
  public:
-  explicit ChapterHtmlSlimParser(const char* filepath, GfxRenderer& renderer, const int fontId,
+  explicit ChapterHtmlSlimParser(ZipEntryReader* reader, GfxRenderer& renderer, const int fontId,
                                  const float lineCompression, const int marginTop, const int marginRight,
                                  const int marginBottom, const int marginLeft, const bool extraParagraphSpacing,
-                                 const std::function<void(std::unique_ptr<Page>)>& completePageFn)
-      : filepath(filepath),
+                                 const std::function<void(std::unique_ptr<Page>)>& completePageFn,
+                                 const std::function<bool()>& continueFn = nullptr)
+      : reader(reader),
         renderer(renderer),
         fontId(fontId),
         lineCompression(lineCompression),
@@ -58,8 +109,18 @@ class ChapterHtmlSlimParser {
         marginBottom(marginBottom),
         marginLeft(marginLeft),
         extraParagraphSpacing(extraParagraphSpacing),
-        completePageFn(completePageFn) {}
+        completePageFn(completePageFn),
+        continueFn(continueFn) {}
   ~ChapterHtmlSlimParser() = default;
+  void setCheckpointFn(const std::function<void(const ParseCheckpoint&)>& fn) { checkpointFn = fn; }
+  // Text blocks and words are written to sink as they are parsed, buildPagesFromTokens() can lay them out again with
+  // any layout parameters
+  void setTokenSink(std::ostream* sink) { tokenSink = sink; }
+  // Picks up from a checkpoint of an earlier parse, the reader must already be positioned at its input offset
+  void resumeFrom(const ParseCheckpoint& checkpoint);
   bool parseAndBuildPages();
+  // Same pages as parseAndBuildPages() would build, from a token stream recorded by an earlier parse rather than the
+  // chapter itself. No reader is needed.
+  bool buildPagesFromTokens(std::istream& tokens);
   void addLineToPage(std::shared_ptr<TextBlock> line);
 };
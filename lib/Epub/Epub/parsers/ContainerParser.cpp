@@ -1,6 +1,7 @@
 #include "ContainerParser.h"
 
 #include <HardwareSerial.h>
+#include <ZipEntryReader.h>
 
 bool ContainerParser::setup() {
   parser = XML_ParserCreate(nullptr);
@@ -23,34 +24,32 @@ ContainerParser::~ContainerParser() {
   }
 }
 
-size_t ContainerParser::write(const uint8_t data) { return write(&data, 1); }
+bool ContainerParser::parse(ZipEntryReader& reader) {
+  if (!parser) return false;
 
-size_t ContainerParser::write(const uint8_t* buffer, const size_t size) {
-  if (!parser) return 0;
-
-  const uint8_t* currentBufferPos = buffer;
-  auto remainingInBuffer = size;
-
-  while (remainingInBuffer > 0) {
+  bool done;
+  do {
     void* const buf = XML_GetBuffer(parser, 1024);
     if (!buf) {
       Serial.printf("[%lu] [CTR] Couldn't allocate buffer\n", millis());
-      return 0;
+      return false;
     }
 
-    const auto toRead = remainingInBuffer < 1024 ? remainingInBuffer : 1024;
-    memcpy(buf, currentBufferPos, toRead);
+    // Read straight into the parser's buffer, stored entries come off SD with no intermediate copy
+    const size_t len = reader.read(static_cast<uint8_t*>(buf), 1024);
+    if (reader.hasFailed()) {
+      Serial.printf("[%lu] [CTR] File read error\n", millis());
+      return false;
+    }
+    done = reader.eof() || len == 0;
 
-    if (XML_ParseBuffer(parser, static_cast<int>(toRead), remainingSize == toRead) == XML_STATUS_ERROR) {
+    if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
       Serial.printf("[%lu] [CTR] Parse error: %s\n", millis(), XML_ErrorString(XML_GetErrorCode(parser)));
-      return 0;
+      return false;
     }
+  } while (!done);
 
-    currentBufferPos += toRead;
-    remainingInBuffer -= toRead;
-    remainingSize -= toRead;
-  }
-  return size;
+  return true;
 }
 
 void XMLCALL ContainerParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
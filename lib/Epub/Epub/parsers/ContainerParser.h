@@ -1,18 +1,17 @@
 #pragma once
-#include <Print.h>
-
 #include <string>
 
 #include "expat.h"
 
-class ContainerParser final : public Print {
+class ZipEntryReader;
+
+class ContainerParser final {
   enum ParserState {
     START,
     IN_CONTAINER,
     IN_ROOTFILES,
   };
 
-  size_t remainingSize;
   XML_Parser parser = nullptr;
   ParserState state = START;
 
@@ -22,11 +21,9 @@ class ContainerParser final : public Print {
  public:
   std::string fullPath;
 
-  explicit ContainerParser(const size_t xmlSize) : remainingSize(xmlSize) {}
-  ~ContainerParser() override;
+  ContainerParser() = default;
+  ~ContainerParser();
 
   bool setup();
-
-  size_t write(uint8_t) override;
-  size_t write(const uint8_t* buffer, size_t size) override;
+  bool parse(ZipEntryReader& reader);
 };
@@ -1,7 +1,9 @@
 #include "ContentOpfParser.h"
 
 #include <HardwareSerial.h>
-#include <ZipFile.h>
+#include <ZipEntryReader.h>
+
+#include <algorithm>
 
 namespace {
 constexpr char MEDIA_TYPE_NCX[] = "application/x-dtbncx+xml";
@@ -30,15 +32,11 @@ ContentOpfParser::~ContentOpfParser() {
   }
 }
 
-size_t ContentOpfParser::write(const uint8_t data) { return write(&data, 1); }
-
-size_t ContentOpfParser::write(const uint8_t* buffer, const size_t size) {
-  if (!parser) return 0;
-
-  const uint8_t* currentBufferPos = buffer;
-  auto remainingInBuffer = size;
+bool ContentOpfParser::parse(ZipEntryReader& reader) {
+  if (!parser) return false;
 
-  while (remainingInBuffer > 0) {
+  bool done;
+  do {
     void* const buf = XML_GetBuffer(parser, 1024);
 
     if (!buf) {
@@ -48,13 +46,18 @@ size_t ContentOpfParser::write(const uint8_t* buffer, const size_t size) {
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
       parser = nullptr;
-      return 0;
+      return false;
     }
 
-    const auto toRead = remainingInBuffer < 1024 ? remainingInBuffer : 1024;
-    memcpy(buf, currentBufferPos, toRead);
+    // Read straight into the parser's buffer, stored entries come off SD with no intermediate copy
+    const size_t len = reader.read(static_cast<uint8_t*>(buf), 1024);
+    if (reader.hasFailed()) {
+      Serial.printf("[%lu] [COF] File read error\n", millis());
+      return false;
+    }
+    done = reader.eof() || len == 0;
 
-    if (XML_ParseBuffer(parser, static_cast<int>(toRead), remainingSize == toRead) == XML_STATUS_ERROR) {
+    if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
       Serial.printf("[%lu] [COF] Parse error at line %lu: %s\n", millis(), XML_GetCurrentLineNumber(parser),
                     XML_ErrorString(XML_GetErrorCode(parser)));
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
@@ -62,15 +65,57 @@ size_t ContentOpfParser::write(const uint8_t* buffer, const size_t size) {
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
       parser = nullptr;
-      return 0;
+      return false;
     }
+  } while (!done);
+
+  Serial.printf("[%lu] [COF] Manifest: %d items, %d spine refs, %d bytes of strings\n", millis(), manifest.size(),
+                spineRefs.size(), arena.size());
+  return true;
+}
+
+const ContentOpfParser::ManifestItem* ContentOpfParser::findManifestItem(const std::string_view itemId) {
+  if (!manifestSorted) {
+    // Stable so that the last of any duplicate ids wins, matching the order they appear in the manifest
+    std::stable_sort(manifest.begin(), manifest.end(),
+                     [](const ManifestItem& a, const ManifestItem& b) { return a.id < b.id; });
+    manifestSorted = true;
+  }
 
-    currentBufferPos += toRead;
-    remainingInBuffer -= toRead;
-    remainingSize -= toRead;
+  const auto it = std::upper_bound(manifest.begin(), manifest.end(), itemId,
+                                   [](const std::string_view id, const ManifestItem& item) { return id < item.id; });
+  if (it == manifest.begin() || (it - 1)->id != itemId) {
+    return nullptr;
   }
+  return &*(it - 1);
+}
+
+std::string ContentOpfParser::getItemHref(const std::string_view itemId) {
+  const auto item = findManifestItem(itemId);
+  if (!item) {
+    return "";
+  }
+
+  std::string href;
+  href.reserve(baseContentPath.size() + item->href.size());
+  href.append(baseContentPath).append(item->href);
+  return href;
+}
+
+void ContentOpfParser::resolveSpine(std::vector<std::pair<std::string, std::string>>& spine) {
+  spine.reserve(spineRefs.size());
+  for (const auto& spineRef : spineRefs) {
+    if (findManifestItem(spineRef)) {
+      spine.emplace_back(std::string(spineRef), getItemHref(spineRef));
+    }
+  }
+}
 
-  return size;
+void ContentOpfParser::release() {
+  std::vector<ManifestItem>().swap(manifest);
+  std::vector<std::string_view>().swap(spineRefs);
+  arena.release();
+  manifestSorted = false;
 }
 
 void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
@@ -121,28 +166,29 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
   }
 
   if (self->state == IN_MANIFEST && (strcmp(name, "item") == 0 || strcmp(name, "opf:item") == 0)) {
-    std::string itemId;
-    std::string href;
-    std::string mediaType;
+    const char* itemId = "";
+    const char* href = "";
+    const char* mediaType = "";
 
     for (int i = 0; atts[i]; i += 2) {
       if (strcmp(atts[i], "id") == 0) {
         itemId = atts[i + 1];
       } else if (strcmp(atts[i], "href") == 0) {
-        href = self->baseContentPath + atts[i + 1];
+        href = atts[i + 1];
       } else if (strcmp(atts[i], "media-type") == 0) {
         mediaType = atts[i + 1];
       }
     }
 
-    self->items[itemId] = href;
+    self->manifest.push_back({self->arena.store(itemId), self->arena.store(href)});
+    self->manifestSorted = false;
 
-    if (mediaType == MEDIA_TYPE_NCX) {
+    if (strcmp(mediaType, MEDIA_TYPE_NCX) == 0) {
       if (self->tocNcxPath.empty()) {
-        self->tocNcxPath = href;
+        self->tocNcxPath = self->baseContentPath + href;
       } else {
         Serial.printf("[%lu] [COF] Warning: Multiple NCX files found in manifest. Ignoring duplicate: %s\n", millis(),
-                      href.c_str());
+                      href);
       }
     }
     return;
@@ -151,7 +197,7 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
   if (self->state == IN_SPINE && (strcmp(name, "itemref") == 0 || strcmp(name, "opf:itemref") == 0)) {
     for (int i = 0; atts[i]; i += 2) {
       if (strcmp(atts[i], "idref") == 0) {
-        self->spineRefs.emplace_back(atts[i + 1]);
+        self->spineRefs.push_back(self->arena.store(atts[i + 1]));
         break;
       }
     }
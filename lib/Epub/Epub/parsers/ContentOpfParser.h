@@ -1,12 +1,14 @@
 #pragma once
-#include <Print.h>
-
-#include <map>
+#include <string_view>
+#include <vector>
 
 #include "Epub.h"
+#include "Epub/StringArena.h"
 #include "expat.h"
 
-class ContentOpfParser final : public Print {
+class ZipEntryReader;
+
+class ContentOpfParser final {
   enum ParserState {
     START,
     IN_PACKAGE,
@@ -16,10 +18,21 @@ class ContentOpfParser final : public Print {
     IN_SPINE,
   };
 
+  // Manifest ids and hrefs are views into the arena, hrefs are stored without baseContentPath
+  struct ManifestItem {
+    std::string_view id;
+    std::string_view href;
+  };
+
   const std::string& baseContentPath;
-  size_t remainingSize;
   XML_Parser parser = nullptr;
   ParserState state = START;
+  StringArena arena;
+  std::vector<ManifestItem> manifest;
+  std::vector<std::string_view> spineRefs;
+  bool manifestSorted = false;
+
+  const ManifestItem* findManifestItem(std::string_view itemId);
 
   static void startElement(void* userData, const XML_Char* name, const XML_Char** atts);
   static void characterData(void* userData, const XML_Char* s, int len);
@@ -29,15 +42,16 @@ class ContentOpfParser final : public Print {
   std::string title;
   std::string tocNcxPath;
   std::string coverItemId;
-  std::map<std::string, std::string> items;
-  std::vector<std::string> spineRefs;
 
-  explicit ContentOpfParser(const std::string& baseContentPath, const size_t xmlSize)
-      : baseContentPath(baseContentPath), remainingSize(xmlSize) {}
-  ~ContentOpfParser() override;
+  explicit ContentOpfParser(const std::string& baseContentPath) : baseContentPath(baseContentPath) {}
+  ~ContentOpfParser();
 
   bool setup();
-
-  size_t write(uint8_t) override;
-  size_t write(const uint8_t* buffer, size_t size) override;
+  bool parse(ZipEntryReader& reader);
+  // Looks up a manifest item by id, returning its full href or an empty string if it isn't in the manifest
+  std::string getItemHref(std::string_view itemId);
+  // Resolves the spine idrefs into (id, href) pairs, skipping any that aren't in the manifest
+  void resolveSpine(std::vector<std::pair<std::string, std::string>>& spine);
+  // Frees the manifest, spine refs and their string storage
+  void release();
 };
@@ -2,6 +2,7 @@
 
 #include <Esp.h>
 #include <HardwareSerial.h>
+#include <ZipEntryReader.h>
 
 bool TocNcxParser::setup() {
   parser = XML_ParserCreate(nullptr);
@@ -26,15 +27,11 @@ TocNcxParser::~TocNcxParser() {
   }
 }
 
-size_t TocNcxParser::write(const uint8_t data) { return write(&data, 1); }
+bool TocNcxParser::parse(ZipEntryReader& reader) {
+  if (!parser) return false;
 
-size_t TocNcxParser::write(const uint8_t* buffer, const size_t size) {
-  if (!parser) return 0;
-
-  const uint8_t* currentBufferPos = buffer;
-  auto remainingInBuffer = size;
-
-  while (remainingInBuffer > 0) {
+  bool done;
+  do {
     void* const buf = XML_GetBuffer(parser, 1024);
     if (!buf) {
       Serial.printf("[%lu] [TOC] Couldn't allocate memory for buffer\n", millis());
@@ -43,13 +40,18 @@ size_t TocNcxParser::write(const uint8_t* buffer, const size_t size) {
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
       parser = nullptr;
-      return 0;
+      return false;
     }
 
-    const auto toRead = remainingInBuffer < 1024 ? remainingInBuffer : 1024;
-    memcpy(buf, currentBufferPos, toRead);
+    // Inflate straight into the parser's buffer
+    const size_t len = reader.read(static_cast<uint8_t*>(buf), 1024);
+    if (reader.hasFailed()) {
+      Serial.printf("[%lu] [TOC] File read error\n", millis());
+      return false;
+    }
+    done = reader.eof() || len == 0;
 
-    if (XML_ParseBuffer(parser, static_cast<int>(toRead), remainingSize == toRead) == XML_STATUS_ERROR) {
+    if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
       Serial.printf("[%lu] [TOC] Parse error at line %lu: %s\n", millis(), XML_GetCurrentLineNumber(parser),
                     XML_ErrorString(XML_GetErrorCode(parser)));
       XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
@@ -57,14 +59,11 @@ size_t TocNcxParser::write(const uint8_t* buffer, const size_t size) {
       XML_SetCharacterDataHandler(parser, nullptr);
       XML_ParserFree(parser);
       parser = nullptr;
-      return 0;
+      return false;
     }
+  } while (!done);
 
-    currentBufferPos += toRead;
-    remainingInBuffer -= toRead;
-    remainingSize -= toRead;
-  }
-  return size;
+  return true;
 }
 
 void XMLCALL TocNcxParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
@@ -1,17 +1,16 @@
 #pragma once
-#include <Print.h>
-
 #include <string>
 #include <vector>
 
 #include "Epub/EpubTocEntry.h"
 #include "expat.h"
 
-class TocNcxParser final : public Print {
+class ZipEntryReader;
+
+class TocNcxParser final {
   enum ParserState { START, IN_NCX, IN_NAV_MAP, IN_NAV_POINT, IN_NAV_LABEL, IN_NAV_LABEL_TEXT, IN_CONTENT };
 
   const std::string& baseContentPath;
-  size_t remainingSize;
   XML_Parser parser = nullptr;
   ParserState state = START;
 
@@ -26,12 +25,9 @@ class TocNcxParser final : public Print {
  public:
   std::vector<EpubTocEntry> toc;
 
-  explicit TocNcxParser(const std::string& baseContentPath, const size_t xmlSize)
-      : baseContentPath(baseContentPath), remainingSize(xmlSize) {}
-  ~TocNcxParser() override;
+  explicit TocNcxParser(const std::string& baseContentPath) : baseContentPath(baseContentPath) {}
+  ~TocNcxParser();
 
   bool setup();
-
-  size_t write(uint8_t) override;
-  size_t write(const uint8_t* buffer, size_t size) override;
+  bool parse(ZipEntryReader& reader);
 };
@@ -4,15 +4,7 @@
 
 void GfxRenderer::insertFont(const int fontId, EpdFontFamily font) { fontMap.insert({fontId, font}); }
 
-void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
-  uint8_t* frameBuffer = einkDisplay.getFrameBuffer();
-
-  // Early return if no framebuffer is set
-  if (!frameBuffer) {
-    Serial.printf("[%lu] [GFX] !! No framebuffer\n", millis());
-    return;
-  }
-
+bool GfxRenderer::pixelIndex(const int x, const int y, uint16_t* byteIndex, uint8_t* bitPosition) {
   // Rotate coordinates: portrait (480x800) -> landscape (800x480)
   // Rotation: 90 degrees clockwise
   const int rotatedX = y;
@@ -22,12 +14,47 @@ void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
   if (rotatedX < 0 || rotatedX >= EInkDisplay::DISPLAY_WIDTH || rotatedY < 0 ||
       rotatedY >= EInkDisplay::DISPLAY_HEIGHT) {
     Serial.printf("[%lu] [GFX] !! Outside range (%d, %d)\n", millis(), x, y);
-    return;
+    return false;
   }
 
   // Calculate byte position and bit position
-  const uint16_t byteIndex = rotatedY * EInkDisplay::DISPLAY_WIDTH_BYTES + (rotatedX / 8);
-  const uint8_t bitPosition = 7 - (rotatedX % 8);  // MSB first
+  *byteIndex = rotatedY * EInkDisplay::DISPLAY_WIDTH_BYTES + (rotatedX / 8);
+  *bitPosition = 7 - (rotatedX % 8);  // MSB first
+  return true;
+}
+
+void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
+  uint8_t* frameBuffer = einkDisplay.getFrameBuffer();
+
+  // Early return if no framebuffer is set
+  if (!frameBuffer && !banding) {
+    Serial.printf("[%lu] [GFX] !! No framebuffer\n", millis());
+    return;
+  }
+
+  uint16_t byteIndex;
+  uint8_t bitPosition;
+  if (!pixelIndex(x, y, &byteIndex, &bitPosition)) {
+    return;
+  }
+
+  if (banding) {
+    if (byteIndex < bandStart || byteIndex >= bandEnd) {
+      return;
+    }
+    // Plain pixels are drawn the same in every mode
+    for (uint8_t* band : bandBuffers) {
+      if (!band) {
+        continue;
+      }
+      if (state) {
+        band[byteIndex - bandStart] &= ~(1 << bitPosition);
+      } else {
+        band[byteIndex - bandStart] |= 1 << bitPosition;
+      }
+    }
+    return;
+  }
 
   if (state) {
     frameBuffer[byteIndex] &= ~(1 << bitPosition);  // Clear bit
@@ -36,6 +63,60 @@ void GfxRenderer::drawPixel(const int x, const int y, const bool state) const {
   }
 }
 
+namespace {
+// Whether a shade is drawn in a mode, and with which pixel state. BW draws everything but white (so also paints over
+// the grays), the gray planes are flagged in reverse as 0 leaves a pixel alone and 1 updates it: MSB marks both grays,
+// LSB only dark gray.
+bool shadeDrawn(const GfxRenderer::RenderMode mode, const uint8_t shade, const bool state, bool* drawnState) {
+  switch (mode) {
+    case GfxRenderer::BW:
+      *drawnState = state;
+      return shade < 3;
+    case GfxRenderer::GRAYSCALE_MSB:
+      *drawnState = false;
+      return shade == 1 || shade == 2;
+    case GfxRenderer::GRAYSCALE_LSB:
+      *drawnState = false;
+      return shade == 1;
+  }
+  return false;
+}
+}  // namespace
+
+void GfxRenderer::drawShadedPixel(const int x, const int y, const uint8_t shade, const bool state) const {
+  bool drawnState;
+  if (!banding) {
+    if (shadeDrawn(renderMode, shade, state, &drawnState)) {
+      drawPixel(x, y, drawnState);
+    }
+    return;
+  }
+
+  uint16_t byteIndex;
+  uint8_t bitPosition;
+  if (!pixelIndex(x, y, &byteIndex, &bitPosition) || byteIndex < bandStart || byteIndex >= bandEnd) {
+    return;
+  }
+  for (int mode = 0; mode < RENDER_MODE_COUNT; mode++) {
+    uint8_t* band = bandBuffers[mode];
+    if (!band || !shadeDrawn(static_cast<RenderMode>(mode), shade, state, &drawnState)) {
+      continue;
+    }
+    if (drawnState) {
+      band[byteIndex - bandStart] &= ~(1 << bitPosition);
+    } else {
+      band[byteIndex - bandStart] |= 1 << bitPosition;
+    }
+  }
+}
+
+bool GfxRenderer::hasGrayscale(const int fontId) const {
+  if (fontMap.count(fontId) == 0) {
+    return false;
+  }
+  return fontMap.at(fontId).getData()->is2Bit;
+}
+
 int GfxRenderer::getTextWidth(const int fontId, const char* text, const EpdFontStyle style) const {
   if (fontMap.count(fontId) == 0) {
     Serial.printf("[%lu] [GFX] Font %d not found\n", millis(), fontId);
@@ -172,13 +253,7 @@ void GfxRenderer::drawBitmap(const Bitmap& bitmap, const int x, const int y, con
 
       const uint8_t val = outputRow[bmpX / 4] >> (6 - ((bmpX * 2) % 8)) & 0x3;
 
-      if (renderMode == BW && val < 3) {
-        drawPixel(screenX, screenY);
-      } else if (renderMode == GRAYSCALE_MSB && (val == 1 || val == 2)) {
-        drawPixel(screenX, screenY, false);
-      } else if (renderMode == GRAYSCALE_LSB && val == 1) {
-        drawPixel(screenX, screenY, false);
-      }
+      drawShadedPixel(screenX, screenY, val, true);
     }
   }
 
@@ -186,6 +261,117 @@ void GfxRenderer::drawBitmap(const Bitmap& bitmap, const int x, const int y, con
   free(rowBytes);
 }
 
+namespace {
+// PackBits style: a control byte below 128 is followed by that many plus one literal bytes, 128 and above repeats the
+// following byte control - 126 times
+constexpr size_t MAX_LITERAL_RUN = 128;
+constexpr size_t MAX_REPEAT_RUN = 129;
+
+void encodeRuns(const uint8_t* data, const size_t size, std::vector<uint8_t>& out) {
+  size_t i = 0;
+  while (i < size) {
+    size_t run = 1;
+    while (i + run < size && run < MAX_REPEAT_RUN && data[i + run] == data[i]) {
+      run++;
+    }
+
+    if (run >= 2) {
+      out.push_back(static_cast<uint8_t>(run + 126));
+      out.push_back(data[i]);
+      i += run;
+      continue;
+    }
+
+    // Literals continue until the next repeat starts
+    size_t literals = 1;
+    while (i + literals < size && literals < MAX_LITERAL_RUN &&
+           !(i + literals + 1 < size && data[i + literals] == data[i + literals + 1])) {
+      literals++;
+    }
+    out.push_back(static_cast<uint8_t>(literals - 1));
+    out.insert(out.end(), data + i, data + i + literals);
+    i += literals;
+  }
+}
+}  // namespace
+
+bool GfxRenderer::renderToPlanes(const RenderMode* modes, const uint8_t* clearColors, const int count,
+                                 const std::function<void()>& draw, std::vector<uint8_t>* planes,
+                                 const std::function<bool()>& cancelled) {
+  // Bands reuse the chunk size of the stored BW buffer, small enough to find on a fragmented heap
+  uint8_t* bands[RENDER_MODE_COUNT] = {nullptr};
+  bool allocated = true;
+  for (int i = 0; i < count; i++) {
+    bands[i] = static_cast<uint8_t*>(malloc(BW_BUFFER_CHUNK_SIZE));
+    allocated = allocated && bands[i];
+  }
+
+  bool completed = allocated;
+  if (!allocated) {
+    Serial.printf("[%lu] [GFX] !! Failed to allocate offscreen bands\n", millis());
+  }
+  for (size_t offset = 0; completed && offset < EInkDisplay::BUFFER_SIZE; offset += BW_BUFFER_CHUNK_SIZE) {
+    // Drawing goes back to the framebuffer while cancelled runs, it may hand the renderer to someone else
+    if (cancelled && cancelled()) {
+      completed = false;
+      break;
+    }
+
+    for (int i = 0; i < count; i++) {
+      memset(bands[i], clearColors[i], BW_BUFFER_CHUNK_SIZE);
+      bandBuffers[modes[i]] = bands[i];
+    }
+    banding = true;
+    bandStart = offset;
+    bandEnd = offset + BW_BUFFER_CHUNK_SIZE;
+    draw();
+    banding = false;
+    for (uint8_t*& band : bandBuffers) {
+      band = nullptr;
+    }
+
+    for (int i = 0; i < count; i++) {
+      encodeRuns(bands[i], BW_BUFFER_CHUNK_SIZE, planes[i]);
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    free(bands[i]);
+  }
+  return completed;
+}
+
+size_t GfxRenderer::drawPlane(const uint8_t* data, const size_t size, size_t* offset) const {
+  uint8_t* frameBuffer = einkDisplay.getFrameBuffer();
+  if (!frameBuffer) {
+    Serial.printf("[%lu] [GFX] !! No framebuffer in drawPlane\n", millis());
+    return 0;
+  }
+
+  size_t i = 0;
+  while (i < size) {
+    const uint8_t control = data[i];
+    const size_t length = control < 128 ? control + 1 : control - 126;
+    const size_t tokenSize = control < 128 ? 1 + length : 2;
+    if (i + tokenSize > size) {
+      break;
+    }
+    if (*offset + length > EInkDisplay::BUFFER_SIZE) {
+      Serial.printf("[%lu] [GFX] !! Plane overruns framebuffer\n", millis());
+      return i;
+    }
+
+    if (control < 128) {
+      memcpy(frameBuffer + *offset, data + i + 1, length);
+    } else {
+      memset(frameBuffer + *offset, data[i + 1], length);
+    }
+    *offset += length;
+    i += tokenSize;
+  }
+  return i;
+}
+
 void GfxRenderer::clearScreen(const uint8_t color) const { einkDisplay.clearScreen(color); }
 
 void GfxRenderer::invertScreen() const {
@@ -383,17 +569,7 @@ void GfxRenderer::renderChar(const EpdFontFamily& fontFamily, const uint32_t cp,
           // 0 -> black, 1 -> dark grey, 2 -> light grey, 3 -> white
           const uint8_t bmpVal = 3 - (byte >> bit_index) & 0x3;
 
-          if (renderMode == BW && bmpVal < 3) {
-            // Black (also paints over the grays in BW mode)
-            drawPixel(screenX, screenY, pixelState);
-          } else if (renderMode == GRAYSCALE_MSB && (bmpVal == 1 || bmpVal == 2)) {
-            // Light gray (also mark the MSB if it's going to be a dark gray too)
-            // We have to flag pixels in reverse for the gray buffers, as 0 leave alone, 1 update
-            drawPixel(screenX, screenY, false);
-          } else if (renderMode == GRAYSCALE_LSB && bmpVal == 1) {
-            // Dark gray
-            drawPixel(screenX, screenY, false);
-          }
+          drawShadedPixel(screenX, screenY, bmpVal, pixelState);
         } else {
           const uint8_t byte = bitmap[pixelPosition / 8];
           const uint8_t bit_index = 7 - (pixelPosition % 8);
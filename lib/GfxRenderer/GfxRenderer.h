@@ -4,13 +4,16 @@
 #include <EpdFontFamily.h>
 #include <FS.h>
 
+#include <functional>
 #include <map>
+#include <vector>
 
 #include "Bitmap.h"
 
 class GfxRenderer {
  public:
   enum RenderMode { BW, GRAYSCALE_LSB, GRAYSCALE_MSB };
+  static constexpr int RENDER_MODE_COUNT = 3;
 
  private:
   static constexpr size_t BW_BUFFER_CHUNK_SIZE = 8000;  // 8KB chunks to allow for non-contiguous memory
@@ -22,6 +25,15 @@ class GfxRenderer {
   RenderMode renderMode;
   uint8_t* bwBufferChunks[BW_BUFFER_NUM_CHUNKS] = {nullptr};
   std::map<int, EpdFontFamily> fontMap;
+  // While banding, drawing goes to the band of every render mode that has one rather than the framebuffer, each as it
+  // would have been drawn in that mode. Only the framebuffer bytes [bandStart, bandEnd) are kept.
+  bool banding = false;
+  uint8_t* bandBuffers[RENDER_MODE_COUNT] = {nullptr};
+  size_t bandStart = 0;
+  size_t bandEnd = 0;
+  static bool pixelIndex(int x, int y, uint16_t* byteIndex, uint8_t* bitPosition);
+  // Draws a pixel of a 2-bit image, 0 is black and 3 white, into whichever planes show that shade
+  void drawShadedPixel(int x, int y, uint8_t shade, bool state) const;
   void renderChar(const EpdFontFamily& fontFamily, uint32_t cp, int* x, const int* y, bool pixelState,
                   EpdFontStyle style) const;
   void freeBwBufferChunks();
@@ -51,6 +63,8 @@ class GfxRenderer {
   void drawBitmap(const Bitmap& bitmap, int x, int y, int maxWidth, int maxHeight) const;
 
   // Text
+  // True if the font has gray levels, otherwise the grayscale planes of text drawn with it stay blank
+  bool hasGrayscale(int fontId) const;
   int getTextWidth(int fontId, const char* text, EpdFontStyle style = REGULAR) const;
   void drawCenteredText(int fontId, int y, const char* text, bool black = true, EpdFontStyle style = REGULAR) const;
   void drawText(int fontId, int x, int y, const char* text, bool black = true, EpdFontStyle style = REGULAR) const;
@@ -65,6 +79,17 @@ class GfxRenderer {
   void storeBwBuffer();
   void restoreBwBuffer();
 
+  // Offscreen planes
+  // Runs draw once per band of the framebuffer with drawing redirected to a scratch band per mode, appending to
+  // planes[i] a run length encoded copy of the framebuffer draw would have produced in modes[i] on a screen cleared to
+  // clearColors[i]. Every mode comes out of the same draw calls. The framebuffer is left untouched. Returns false if it
+  // ran out of memory or cancelled returned true between bands.
+  bool renderToPlanes(const RenderMode* modes, const uint8_t* clearColors, int count, const std::function<void()>& draw,
+                      std::vector<uint8_t>* planes, const std::function<bool()>& cancelled = nullptr);
+  // Decodes whole runs of a plane into the framebuffer starting at *offset, returning the number of bytes consumed so
+  // a plane can be fed in pieces. The plane is complete once *offset reaches getBufferSize().
+  size_t drawPlane(const uint8_t* data, size_t size, size_t* offset) const;
+
   // Low level functions
   uint8_t* getFrameBuffer() const;
   static size_t getBufferSize();
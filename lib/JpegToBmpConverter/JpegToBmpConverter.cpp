@@ -1,5 +1,7 @@
 #include "JpegToBmpConverter.h"
 
+#include <HardwareSerial.h>
+#include <ZipEntryReader.h>
 #include <picojpeg.h>
 
 #include <cstdio>
@@ -7,7 +9,7 @@
 
 // Context structure for picojpeg callback
 struct JpegReadContext {
-  File& file;
+  ZipEntryReader& reader;
   uint8_t buffer[512];
   size_t bufferPos;
   size_t bufferFilled;
@@ -90,13 +92,13 @@ unsigned char JpegToBmpConverter::jpegReadCallback(unsigned char* pBuf, const un
                                                    unsigned char* pBytes_actually_read, void* pCallback_data) {
   auto* context = static_cast<JpegReadContext*>(pCallback_data);
 
-  if (!context || !context->file) {
+  if (!context || context->reader.hasFailed()) {
     return PJPG_STREAM_READ_ERROR;
   }
 
   // Check if we need to refill our context buffer
   if (context->bufferPos >= context->bufferFilled) {
-    context->bufferFilled = context->file.read(context->buffer, sizeof(context->buffer));
+    context->bufferFilled = context->reader.read(context->buffer, sizeof(context->buffer));
     context->bufferPos = 0;
 
     if (context->bufferFilled == 0) {
@@ -117,12 +119,12 @@ unsigned char JpegToBmpConverter::jpegReadCallback(unsigned char* pBuf, const un
   return 0;  // Success
 }
 
-// Core function: Convert JPEG file to 2-bit BMP
-bool JpegToBmpConverter::jpegFileToBmpStream(File& jpegFile, Print& bmpOut) {
+// Core function: Convert JPEG entry to 2-bit BMP, inflating the entry as picojpeg consumes it
+bool JpegToBmpConverter::jpegToBmpStream(ZipEntryReader& jpegEntry, Print& bmpOut) {
   Serial.printf("[%lu] [JPG] Converting JPEG to BMP\n", millis());
 
   // Setup context for picojpeg callback
-  JpegReadContext context = {.file = jpegFile, .bufferPos = 0, .bufferFilled = 0};
+  JpegReadContext context = {.reader = jpegEntry, .bufferPos = 0, .bufferFilled = 0};
 
   // Initialize picojpeg decoder
   pjpeg_image_info_t imageInfo;
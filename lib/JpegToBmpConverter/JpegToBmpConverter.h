@@ -1,8 +1,8 @@
 #pragma once
 
-#include <FS.h>
+#include <Print.h>
 
-class ZipFile;
+class ZipEntryReader;
 
 class JpegToBmpConverter {
   static void writeBmpHeader(Print& bmpOut, int width, int height);
@@ -11,5 +11,5 @@ class JpegToBmpConverter {
                                         unsigned char* pBytes_actually_read, void* pCallback_data);
 
  public:
-  static bool jpegFileToBmpStream(File& jpegFile, Print& bmpOut);
+  static bool jpegToBmpStream(ZipEntryReader& jpegEntry, Print& bmpOut);
 };
@@ -0,0 +1,193 @@
+#include "LzssStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace serialization {
+namespace {
+constexpr uint16_t NO_POSITION = 0xFFFF;
+
+uint32_t hashAt(const char* p) {
+  const uint32_t v = static_cast<uint8_t>(p[0]) | static_cast<uint8_t>(p[1]) << 8 | static_cast<uint8_t>(p[2]) << 16;
+  return (v * 2654435761u) >> (32 - 10);
+}
+}  // namespace
+
+LzssOutputBuffer::LzssOutputBuffer(std::ostream& sink)
+    : sink(sink), buffer(new char[lzss::WINDOW_SIZE * 2]), hashHeads(new uint16_t[1 << HASH_BITS]) {
+  static_assert(HASH_BITS == 10, "hashAt() assumes 10 hash bits");
+  for (int i = 0; i < 1 << HASH_BITS; i++) {
+    hashHeads[i] = NO_POSITION;
+  }
+}
+
+LzssOutputBuffer::~LzssOutputBuffer() { finish(); }
+
+void LzssOutputBuffer::writeBits(const uint32_t value, const int count) {
+  bitBuffer = bitBuffer << count | value;
+  bitCount += count;
+  while (bitCount >= 8) {
+    bitCount -= 8;
+    sink.put(static_cast<char>(bitBuffer >> bitCount));
+  }
+}
+
+void LzssOutputBuffer::encode(const uint32_t limit) {
+  while (encodePos < limit) {
+    const uint32_t available = fillPos - encodePos;
+    uint32_t matchLength = 0;
+    uint32_t matchDistance = 0;
+
+    if (available >= lzss::MIN_MATCH) {
+      // Single candidate per hash, keeps the encoder cheap enough to run while paginating
+      const uint32_t hash = hashAt(&buffer[encodePos]);
+      const uint16_t candidate = hashHeads[hash];
+      hashHeads[hash] = encodePos;
+
+      if (candidate != NO_POSITION && encodePos - candidate < lzss::WINDOW_SIZE) {
+        const uint32_t maxLength = available < lzss::MAX_MATCH ? available : lzss::MAX_MATCH;
+        while (matchLength < maxLength && buffer[candidate + matchLength] == buffer[encodePos + matchLength]) {
+          matchLength++;
+        }
+        matchDistance = encodePos - candidate;
+      }
+    }
+
+    if (matchLength >= lzss::MIN_MATCH) {
+      writeBits(0, 1);
+      writeBits(matchDistance, lzss::WINDOW_BITS);
+      writeBits(matchLength - lzss::MIN_MATCH, lzss::LENGTH_BITS);
+      for (uint32_t i = 1; i < matchLength; i++) {
+        if (encodePos + i + lzss::MIN_MATCH <= fillPos) {
+          hashHeads[hashAt(&buffer[encodePos + i])] = encodePos + i;
+        }
+      }
+      encodePos += matchLength;
+    } else {
+      writeBits(0x100 | static_cast<uint8_t>(buffer[encodePos]), 9);
+      encodePos++;
+    }
+  }
+}
+
+void LzssOutputBuffer::slide() {
+  memmove(&buffer[0], &buffer[lzss::WINDOW_SIZE], lzss::WINDOW_SIZE);
+  encodePos -= lzss::WINDOW_SIZE;
+  fillPos -= lzss::WINDOW_SIZE;
+  for (int i = 0; i < 1 << HASH_BITS; i++) {
+    hashHeads[i] = hashHeads[i] != NO_POSITION && hashHeads[i] >= lzss::WINDOW_SIZE ? hashHeads[i] - lzss::WINDOW_SIZE
+                                                                                     : NO_POSITION;
+  }
+}
+
+LzssOutputBuffer::int_type LzssOutputBuffer::overflow(const int_type ch) {
+  if (ch == traits_type::eof()) {
+    return traits_type::not_eof(ch);
+  }
+  const char c = traits_type::to_char_type(ch);
+  return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+}
+
+std::streamsize LzssOutputBuffer::xsputn(const char* s, const std::streamsize n) {
+  if (finished) {
+    return 0;
+  }
+
+  std::streamsize written = 0;
+  while (written < n) {
+    if (fillPos == lzss::WINDOW_SIZE * 2) {
+      // Leave a full match worth of lookahead so matches aren't cut short at the buffer edge
+      encode(fillPos - lzss::MAX_MATCH);
+      slide();
+    }
+
+    const auto chunk = std::min<std::streamsize>(n - written, lzss::WINDOW_SIZE * 2 - fillPos);
+    memcpy(&buffer[fillPos], s + written, chunk);
+    fillPos += chunk;
+    written += chunk;
+  }
+  return written;
+}
+
+void LzssOutputBuffer::finish() {
+  if (finished) {
+    return;
+  }
+  finished = true;
+
+  encode(fillPos);
+  // End marker is a match with a distance of 0, then pad out the last byte
+  writeBits(0, 1 + lzss::WINDOW_BITS + lzss::LENGTH_BITS);
+  if (bitCount > 0) {
+    writeBits(0, 8 - bitCount);
+  }
+}
+
+bool LzssInputBuffer::readBits(const int count, uint32_t* value) {
+  while (bitCount < count) {
+    if (readPos == readEnd) {
+      source.read(readBuffer, READ_CHUNK_SIZE);
+      readPos = 0;
+      readEnd = source.gcount();
+      if (readEnd == 0) {
+        return false;
+      }
+    }
+    bitBuffer = bitBuffer << 8 | static_cast<uint8_t>(readBuffer[readPos++]);
+    bitCount += 8;
+  }
+
+  bitCount -= count;
+  *value = bitBuffer >> bitCount & ((1u << count) - 1);
+  return true;
+}
+
+LzssInputBuffer::int_type LzssInputBuffer::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  constexpr uint32_t windowMask = lzss::WINDOW_SIZE - 1;
+  size_t produced = 0;
+  while (produced < OUTPUT_CHUNK_SIZE && !ended) {
+    if (pendingLength > 0) {
+      const char c = window[(windowPos - pendingDistance) & windowMask];
+      window[windowPos++ & windowMask] = c;
+      output[produced++] = c;
+      pendingLength--;
+      continue;
+    }
+
+    uint32_t isLiteral, value;
+    if (!readBits(1, &isLiteral)) {
+      break;
+    }
+
+    if (isLiteral) {
+      if (!readBits(8, &value)) {
+        break;
+      }
+      window[windowPos++ & windowMask] = static_cast<char>(value);
+      output[produced++] = static_cast<char>(value);
+      continue;
+    }
+
+    uint32_t length;
+    if (!readBits(lzss::WINDOW_BITS, &value) || !readBits(lzss::LENGTH_BITS, &length)) {
+      break;
+    }
+    if (value == 0) {
+      ended = true;
+      break;
+    }
+    pendingDistance = value;
+    pendingLength = length + lzss::MIN_MATCH;
+  }
+
+  if (produced == 0) {
+    return traits_type::eof();
+  }
+  setg(output, output, output + produced);
+  return traits_type::to_int_type(output[0]);
+}
+}  // namespace serialization
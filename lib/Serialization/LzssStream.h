@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+namespace serialization {
+/**
+ * Small LZSS codec in the style of heatshrink, exposed as stream buffers so cache writers can opt in by wrapping their
+ * stream.
+ *
+ * The stream is a sequence of bit packed tokens, MSB first: a 1 bit followed by an 8 bit literal, or a 0 bit followed
+ * by an 11 bit distance and a 4 bit length for a match of 3-18 bytes inside the last 2047 bytes. A distance of 0 marks
+ * the end of the stream. The encoder allocates ~6KB and the decoder ~2.3KB on the heap, however much data passes
+ * through.
+ */
+namespace lzss {
+constexpr int WINDOW_BITS = 11;
+constexpr int LENGTH_BITS = 4;
+constexpr uint32_t WINDOW_SIZE = 1 << WINDOW_BITS;
+constexpr uint32_t MIN_MATCH = 3;
+constexpr uint32_t MAX_MATCH = MIN_MATCH + (1 << LENGTH_BITS) - 1;
+}  // namespace lzss
+
+// Compresses everything written to it into sink, finish() (or destruction) writes the end marker
+class LzssOutputBuffer final : public std::streambuf {
+  static constexpr int HASH_BITS = 10;
+
+  std::ostream& sink;
+  // Twice the window so the window plus pending input can be held without wrapping, halves slide down when full
+  std::unique_ptr<char[]> buffer;
+  std::unique_ptr<uint16_t[]> hashHeads;
+  uint32_t encodePos = 0;
+  uint32_t fillPos = 0;
+  uint32_t bitBuffer = 0;
+  int bitCount = 0;
+  bool finished = false;
+
+  void writeBits(uint32_t value, int count);
+  void encode(uint32_t limit);
+  void slide();
+
+ protected:
+  int_type overflow(int_type ch) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+ public:
+  explicit LzssOutputBuffer(std::ostream& sink);
+  ~LzssOutputBuffer() override;
+  void finish();
+};
+
+// Decompresses a stream written by LzssOutputBuffer, may read ahead of the end of the compressed data in source
+class LzssInputBuffer final : public std::streambuf {
+  static constexpr size_t READ_CHUNK_SIZE = 128;
+  static constexpr size_t OUTPUT_CHUNK_SIZE = 128;
+
+  std::istream& source;
+  std::unique_ptr<char[]> window;
+  uint32_t windowPos = 0;
+  char readBuffer[READ_CHUNK_SIZE];
+  size_t readPos = 0;
+  size_t readEnd = 0;
+  char output[OUTPUT_CHUNK_SIZE];
+  uint32_t bitBuffer = 0;
+  int bitCount = 0;
+  // Remaining bytes of a match that didn't fit in the last output chunk
+  uint32_t pendingDistance = 0;
+  uint32_t pendingLength = 0;
+  bool ended = false;
+
+  bool readBits(int count, uint32_t* value);
+
+ protected:
+  int_type underflow() override;
+
+ public:
+  explicit LzssInputBuffer(std::istream& source) : source(source), window(new char[lzss::WINDOW_SIZE]) {}
+  // True if the end marker was reached rather than the source running out
+  bool reachedEnd() const { return ended; }
+};
+}  // namespace serialization
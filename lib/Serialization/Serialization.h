@@ -24,4 +24,59 @@ static void readString(std::istream& is, std::string& s) {
   s.resize(len);
   is.read(&s[0], len);
 }
+
+// LEB128 style, 7 bits a byte with the high bit set on all but the last byte
+static void writeVarint(std::ostream& os, uint32_t value) {
+  while (value >= 0x80) {
+    os.put(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  os.put(static_cast<char>(value));
+}
+
+static void readVarint(std::istream& is, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    const int byte = is.get();
+    if (byte == std::char_traits<char>::eof()) {
+      return;
+    }
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return;
+    }
+  }
+}
+
+// Zigzag maps small negative numbers to small varints
+static void writeSignedVarint(std::ostream& os, const int32_t value) {
+  writeVarint(os, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+}
+
+static void readSignedVarint(std::istream& is, int32_t& value) {
+  uint32_t encoded;
+  readVarint(is, encoded);
+  value = static_cast<int32_t>((encoded >> 1) ^ (~(encoded & 1) + 1));
+}
+// Buffer variants advance p past the value, returning false rather than reading beyond end
+static bool readVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && p < end; shift += 7) {
+    const uint8_t byte = *p++;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool readSignedVarint(const uint8_t*& p, const uint8_t* end, int32_t& value) {
+  uint32_t encoded;
+  if (!readVarint(p, end, encoded)) {
+    return false;
+  }
+  value = static_cast<int32_t>((encoded >> 1) ^ (~(encoded & 1) + 1));
+  return true;
+}
 }  // namespace serialization
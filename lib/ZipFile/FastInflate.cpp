@@ -0,0 +1,510 @@
+#include "FastInflate.h"
+
+#include <HardwareSerial.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr uint8_t LITLEN_TABLE_BITS = 10;
+constexpr uint8_t DIST_TABLE_BITS = 9;
+constexpr uint8_t CODELEN_TABLE_BITS = 7;
+// Root table plus the worst case sub tables for codes of up to 15 bits (zlib's ENOUGH values)
+constexpr uint16_t LITLEN_TABLE_SIZE = 1332;
+constexpr uint16_t DIST_TABLE_SIZE = 592;
+constexpr uint16_t CODELEN_TABLE_SIZE = 1 << CODELEN_TABLE_BITS;
+constexpr uint8_t MAX_CODE_LENGTH = 15;
+constexpr uint16_t MAX_LITLEN_CODES = 286;
+constexpr uint16_t MAX_DIST_CODES = 30;
+// Room for two literal pairs or the longest match plus word copy overrun, below this output is bounds checked per byte
+constexpr ptrdiff_t FAST_OUTPUT_MARGIN = 258 + 4;
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,    65,    97,    129,
+                                193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3,  3,  4,  4,  5,  5,  6,
+                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Order the code length code lengths are sent in
+const uint8_t CODELEN_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Table entry layout: bits 0-4 are the number of bits to consume, bits 5-7 the kind, bits 8-15 the first value and
+// bits 16-31 the second value. Literal pairs hold both literals, lengths and distances hold extra bits and base, and
+// sub table links hold the sub table bits and offset.
+// LITERAL and LITERAL_PAIR double as the number of bytes they produce.
+enum EntryKind : uint8_t { INVALID, LITERAL, LITERAL_PAIR, BASE_EXTRA, END_OF_BLOCK, SUB_TABLE };
+enum TableType { LITLEN_TABLE, DIST_TABLE, CODELEN_TABLE };
+
+constexpr uint32_t makeEntry(const uint32_t bits, const EntryKind kind, const uint32_t first, const uint32_t second) {
+  return bits | static_cast<uint32_t>(kind) << 5 | first << 8 | second << 16;
+}
+inline uint32_t entryBits(const uint32_t entry) { return entry & 0x1F; }
+inline EntryKind entryKind(const uint32_t entry) { return static_cast<EntryKind>((entry >> 5) & 0x7); }
+inline uint32_t entryFirst(const uint32_t entry) { return (entry >> 8) & 0xFF; }
+inline uint32_t entrySecond(const uint32_t entry) { return entry >> 16; }
+
+struct FastInflateState {
+  struct Bits {
+    const uint8_t* in;
+    const uint8_t* inEnd;
+    uint32_t bitBuffer;
+    uint32_t bitCount;
+    // Zero bytes fed in past the end of the input, consuming any of them means the stream was truncated
+    uint32_t overrun;
+  } bits;
+  bool fixedTablesBuilt;
+  uint32_t litlenTable[LITLEN_TABLE_SIZE];
+  uint32_t distTable[DIST_TABLE_SIZE];
+};
+
+// Tops the bit buffer up to at least 25 bits, enough for any code plus its extra bits except distance extra bits
+inline void refill(FastInflateState::Bits& s) {
+  if (s.bitCount > 24) {
+    return;
+  }
+
+  if (s.inEnd - s.in >= 4) {
+    // Load a whole word and only count the bytes that fully fit. The bits above bitCount always hold the upcoming
+    // input, so loading the same bytes again later is harmless.
+    uint32_t word;
+    memcpy(&word, s.in, sizeof(word));
+    s.bitBuffer |= word << s.bitCount;
+    s.in += (31 - s.bitCount) >> 3;
+    s.bitCount |= 24;
+    return;
+  }
+
+  while (s.bitCount <= 24) {
+    if (s.in < s.inEnd) {
+      s.bitBuffer |= static_cast<uint32_t>(*s.in++) << s.bitCount;
+    } else {
+      s.overrun++;
+    }
+    s.bitCount += 8;
+  }
+}
+
+inline void dropBits(FastInflateState::Bits& s, const uint32_t count) {
+  s.bitBuffer >>= count;
+  s.bitCount -= count;
+}
+
+inline uint32_t getBits(FastInflateState::Bits& s, const uint32_t count) {
+  const uint32_t value = s.bitBuffer & ((1u << count) - 1);
+  dropBits(s, count);
+  return value;
+}
+
+uint32_t symbolEntry(const TableType type, const uint16_t symbol) {
+  switch (type) {
+    case LITLEN_TABLE:
+      if (symbol < 256) return makeEntry(0, LITERAL, symbol, 0);
+      if (symbol == 256) return makeEntry(0, END_OF_BLOCK, 0, 0);
+      if (symbol < MAX_LITLEN_CODES) {
+        return makeEntry(0, BASE_EXTRA, LENGTH_EXTRA[symbol - 257], LENGTH_BASE[symbol - 257]);
+      }
+      return makeEntry(0, INVALID, 0, 0);
+    case DIST_TABLE:
+      if (symbol < MAX_DIST_CODES) return makeEntry(0, BASE_EXTRA, DIST_EXTRA[symbol], DIST_BASE[symbol]);
+      return makeEntry(0, INVALID, 0, 0);
+    default:
+      return makeEntry(0, LITERAL, symbol, 0);
+  }
+}
+
+uint16_t reverseBits(uint16_t code, const uint32_t length) {
+  uint16_t reversed = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    reversed = reversed << 1 | (code & 1);
+    code >>= 1;
+  }
+  return reversed;
+}
+
+// Builds a lookup table for a canonical Huffman code. Codes longer than rootBits go through a sub table per root
+// prefix. Incomplete codes are allowed and leave invalid entries behind.
+bool buildTable(const uint8_t* lengths, const uint16_t count, const TableType type, uint32_t* table,
+                const uint16_t tableSize, const uint8_t rootBits) {
+  uint16_t lengthCounts[MAX_CODE_LENGTH + 1] = {};
+  for (uint16_t i = 0; i < count; i++) {
+    lengthCounts[lengths[i]]++;
+  }
+  lengthCounts[0] = 0;
+
+  int32_t left = 1;
+  for (uint32_t length = 1; length <= MAX_CODE_LENGTH; length++) {
+    left = (left << 1) - lengthCounts[length];
+    if (left < 0) {
+      // Over-subscribed
+      return false;
+    }
+  }
+
+  uint16_t firstCode[MAX_CODE_LENGTH + 1] = {};
+  uint16_t code = 0;
+  for (uint32_t length = 1; length <= MAX_CODE_LENGTH; length++) {
+    code = (code + lengthCounts[length - 1]) << 1;
+    firstCode[length] = code;
+  }
+
+  const uint32_t rootSize = 1u << rootBits;
+  const uint32_t rootMask = rootSize - 1;
+  for (uint32_t i = 0; i < rootSize; i++) {
+    table[i] = makeEntry(0, INVALID, 0, 0);
+  }
+
+  // Size each sub table for the longest code sharing its root prefix
+  uint8_t subTableLengths[1 << LITLEN_TABLE_BITS] = {};
+  uint16_t nextCode[MAX_CODE_LENGTH + 1];
+  memcpy(nextCode, firstCode, sizeof(nextCode));
+  for (uint16_t symbol = 0; symbol < count; symbol++) {
+    const uint8_t length = lengths[symbol];
+    if (length > rootBits) {
+      const uint32_t prefix = reverseBits(nextCode[length]++, length) & rootMask;
+      if (length > subTableLengths[prefix]) {
+        subTableLengths[prefix] = length;
+      }
+    }
+  }
+
+  uint32_t used = rootSize;
+  for (uint32_t prefix = 0; prefix < rootSize; prefix++) {
+    if (subTableLengths[prefix] == 0) {
+      continue;
+    }
+
+    const uint32_t subBits = subTableLengths[prefix] - rootBits;
+    if (used + (1u << subBits) > tableSize) {
+      return false;
+    }
+    table[prefix] = makeEntry(rootBits, SUB_TABLE, subBits, used);
+    for (uint32_t i = 0; i < 1u << subBits; i++) {
+      table[used + i] = makeEntry(0, INVALID, 0, 0);
+    }
+    used += 1u << subBits;
+  }
+
+  memcpy(nextCode, firstCode, sizeof(nextCode));
+  for (uint16_t symbol = 0; symbol < count; symbol++) {
+    const uint8_t length = lengths[symbol];
+    if (length == 0) {
+      continue;
+    }
+
+    const uint32_t reversed = reverseBits(nextCode[length]++, length);
+    const uint32_t entry = symbolEntry(type, symbol);
+    if (length <= rootBits) {
+      for (uint32_t i = reversed; i < rootSize; i += 1u << length) {
+        table[i] = entry | length;
+      }
+    } else {
+      const uint32_t subTable = table[reversed & rootMask];
+      const uint32_t subLength = length - rootBits;
+      for (uint32_t i = reversed >> rootBits; i < 1u << entryFirst(subTable); i += 1u << subLength) {
+        table[entrySecond(subTable) + i] = entry | subLength;
+      }
+    }
+  }
+
+  if (type == LITLEN_TABLE) {
+    // Pair up literals short enough that two fit in the root bits, so text decodes two bytes per lookup.
+    // Walk backwards so the second lookup always lands on an entry that has not been paired yet.
+    for (uint32_t i = rootSize; i-- > 0;) {
+      const uint32_t first = table[i];
+      if (entryKind(first) != LITERAL) {
+        continue;
+      }
+
+      const uint32_t firstLength = entryBits(first);
+      const uint32_t second = table[i >> firstLength];
+      if (entryKind(second) != LITERAL || entryBits(second) > rootBits - firstLength) {
+        continue;
+      }
+      table[i] = makeEntry(firstLength + entryBits(second), LITERAL_PAIR, entryFirst(first), entryFirst(second));
+    }
+  }
+
+  return true;
+}
+
+bool buildFixedTables(FastInflateState& s) {
+  if (s.fixedTablesBuilt) {
+    return true;
+  }
+
+  uint8_t lengths[288 + 32];
+  memset(lengths, 8, 144);
+  memset(lengths + 144, 9, 112);
+  memset(lengths + 256, 7, 24);
+  memset(lengths + 280, 8, 8);
+  memset(lengths + 288, 5, 32);
+
+  s.fixedTablesBuilt = buildTable(lengths, 288, LITLEN_TABLE, s.litlenTable, LITLEN_TABLE_SIZE, LITLEN_TABLE_BITS) &&
+                       buildTable(lengths + 288, 32, DIST_TABLE, s.distTable, DIST_TABLE_SIZE, DIST_TABLE_BITS);
+  return s.fixedTablesBuilt;
+}
+
+bool readDynamicTables(FastInflateState& state) {
+  state.fixedTablesBuilt = false;
+  FastInflateState::Bits& s = state.bits;
+
+  refill(s);
+  const uint16_t litlenCount = getBits(s, 5) + 257;
+  const uint16_t distCount = getBits(s, 5) + 1;
+  const uint8_t codelenCount = getBits(s, 4) + 4;
+  if (litlenCount > MAX_LITLEN_CODES || distCount > MAX_DIST_CODES) {
+    return false;
+  }
+
+  uint8_t codelenLengths[19] = {};
+  for (uint8_t i = 0; i < codelenCount; i++) {
+    refill(s);
+    codelenLengths[CODELEN_ORDER[i]] = getBits(s, 3);
+  }
+
+  uint32_t codelenTable[CODELEN_TABLE_SIZE];
+  if (!buildTable(codelenLengths, 19, CODELEN_TABLE, codelenTable, CODELEN_TABLE_SIZE, CODELEN_TABLE_BITS)) {
+    return false;
+  }
+
+  uint8_t lengths[MAX_LITLEN_CODES + MAX_DIST_CODES];
+  const uint16_t total = litlenCount + distCount;
+  uint16_t i = 0;
+  while (i < total) {
+    refill(s);
+    const uint32_t entry = codelenTable[s.bitBuffer & (CODELEN_TABLE_SIZE - 1)];
+    if (entryKind(entry) != LITERAL) {
+      return false;
+    }
+    dropBits(s, entryBits(entry));
+
+    const uint32_t symbol = entryFirst(entry);
+    if (symbol < 16) {
+      lengths[i++] = symbol;
+      continue;
+    }
+
+    uint8_t repeatLength = 0;
+    uint32_t repeatCount;
+    if (symbol == 16) {
+      if (i == 0) {
+        return false;
+      }
+      repeatLength = lengths[i - 1];
+      repeatCount = 3 + getBits(s, 2);
+    } else if (symbol == 17) {
+      repeatCount = 3 + getBits(s, 3);
+    } else {
+      repeatCount = 11 + getBits(s, 7);
+    }
+
+    if (i + repeatCount > total) {
+      return false;
+    }
+    memset(lengths + i, repeatLength, repeatCount);
+    i += repeatCount;
+  }
+
+  // A block without an end of block code can never finish
+  if (lengths[256] == 0) {
+    return false;
+  }
+
+  return buildTable(lengths, litlenCount, LITLEN_TABLE, state.litlenTable, LITLEN_TABLE_SIZE, LITLEN_TABLE_BITS) &&
+         buildTable(lengths + litlenCount, distCount, DIST_TABLE, state.distTable, DIST_TABLE_SIZE, DIST_TABLE_BITS);
+}
+
+bool copyStoredBlock(FastInflateState::Bits& s, uint8_t*& outNext, const uint8_t* outEnd) {
+  // Drop to the byte boundary and hand any whole bytes still in the bit buffer back to the input
+  dropBits(s, s.bitCount & 7);
+  if (s.overrun > s.bitCount >> 3) {
+    return false;
+  }
+  s.in -= (s.bitCount >> 3) - s.overrun;
+  s.bitBuffer = 0;
+  s.bitCount = 0;
+  s.overrun = 0;
+
+  if (s.inEnd - s.in < 4) {
+    return false;
+  }
+  const uint32_t length = s.in[0] | s.in[1] << 8;
+  const uint32_t invertedLength = s.in[2] | s.in[3] << 8;
+  s.in += 4;
+  if (length != (~invertedLength & 0xFFFF) || s.inEnd - s.in < length || outEnd - outNext < length) {
+    return false;
+  }
+
+  memcpy(outNext, s.in, length);
+  outNext += length;
+  s.in += length;
+  return true;
+}
+
+inline void copyMatch(uint8_t* out, const uint32_t distance, const uint32_t length, const uint8_t* outEnd) {
+  const uint8_t* src = out - distance;
+
+  if (distance >= sizeof(uint32_t) && static_cast<size_t>(outEnd - out) >= length + 3) {
+    // Word copies can run up to 3 bytes past the match, those get overwritten by whatever is decoded next
+    const uint8_t* const end = out + length;
+    do {
+      uint32_t word;
+      memcpy(&word, src, sizeof(word));
+      memcpy(out, &word, sizeof(word));
+      src += sizeof(word);
+      out += sizeof(word);
+    } while (out < end);
+    return;
+  }
+
+  if (distance == 1) {
+    memset(out, *src, length);
+    return;
+  }
+
+  for (uint32_t i = 0; i < length; i++) {
+    out[i] = src[i];
+  }
+}
+
+bool decodeBlock(FastInflateState& state, const uint8_t* outStart, uint8_t*& outNext, const uint8_t* outEnd) {
+  // Work on a local copy so the bit buffer stays in registers, output stores could otherwise alias the state
+  FastInflateState::Bits s = state.bits;
+  uint8_t* out = outNext;
+  const uint32_t* litlenTable = state.litlenTable;
+  const uint32_t* distTable = state.distTable;
+  bool success = false;
+
+  while (true) {
+    refill(s);
+    if (s.overrun && s.overrun * 8 > s.bitCount) {
+      break;
+    }
+
+    uint32_t entry = litlenTable[s.bitBuffer & ((1u << LITLEN_TABLE_BITS) - 1)];
+    if (entryKind(entry) == SUB_TABLE) {
+      dropBits(s, LITLEN_TABLE_BITS);
+      entry = litlenTable[entrySecond(entry) + (s.bitBuffer & ((1u << entryFirst(entry)) - 1))];
+    }
+    dropBits(s, entryBits(entry));
+
+    const EntryKind kind = entryKind(entry);
+    if (kind == LITERAL || kind == LITERAL_PAIR) {
+      if (outEnd - out >= FAST_OUTPUT_MARGIN) {
+        // Plenty of room, so write both bytes and only advance by the number of literals
+        out[0] = entryFirst(entry);
+        out[1] = entrySecond(entry);
+        out += kind;
+
+        // Literals leave at least 10 bits behind, enough for another root lookup without a refill
+        entry = litlenTable[s.bitBuffer & ((1u << LITLEN_TABLE_BITS) - 1)];
+        const EntryKind nextKind = entryKind(entry);
+        if (nextKind == LITERAL || nextKind == LITERAL_PAIR) {
+          dropBits(s, entryBits(entry));
+          out[0] = entryFirst(entry);
+          out[1] = entrySecond(entry);
+          out += nextKind;
+        }
+        continue;
+      }
+
+      if (outEnd - out < kind) {
+        break;
+      }
+      out[0] = entryFirst(entry);
+      if (kind == LITERAL_PAIR) {
+        out[1] = entrySecond(entry);
+      }
+      out += kind;
+      continue;
+    }
+
+    if (kind == END_OF_BLOCK) {
+      success = true;
+      break;
+    }
+
+    if (kind != BASE_EXTRA) {
+      break;
+    }
+
+    const uint32_t length = entrySecond(entry) + getBits(s, entryFirst(entry));
+
+    refill(s);
+    entry = distTable[s.bitBuffer & ((1u << DIST_TABLE_BITS) - 1)];
+    if (entryKind(entry) == SUB_TABLE) {
+      dropBits(s, DIST_TABLE_BITS);
+      entry = distTable[entrySecond(entry) + (s.bitBuffer & ((1u << entryFirst(entry)) - 1))];
+    }
+    dropBits(s, entryBits(entry));
+    if (entryKind(entry) != BASE_EXTRA) {
+      break;
+    }
+
+    // Distance extra bits can take up to 13 bits on top of the code
+    refill(s);
+    const uint32_t distance = entrySecond(entry) + getBits(s, entryFirst(entry));
+
+    if (distance > static_cast<size_t>(out - outStart) || length > static_cast<size_t>(outEnd - out)) {
+      break;
+    }
+    copyMatch(out, distance, length, outEnd);
+    out += length;
+  }
+
+  state.bits = s;
+  outNext = out;
+  return success;
+}
+
+bool inflateBlocks(FastInflateState& state, uint8_t* output, const size_t outputSize) {
+  FastInflateState::Bits& s = state.bits;
+  uint8_t* outNext = output;
+  const uint8_t* outEnd = output + outputSize;
+
+  bool finalBlock;
+  do {
+    refill(s);
+    finalBlock = getBits(s, 1);
+    const uint32_t type = getBits(s, 2);
+
+    bool success;
+    if (type == 0) {
+      success = copyStoredBlock(s, outNext, outEnd);
+    } else if (type == 1) {
+      success = buildFixedTables(state) && decodeBlock(state, output, outNext, outEnd);
+    } else if (type == 2) {
+      success = readDynamicTables(state) && decodeBlock(state, output, outNext, outEnd);
+    } else {
+      success = false;
+    }
+
+    if (!success) {
+      return false;
+    }
+  } while (!finalBlock);
+
+  return outNext == outEnd && s.overrun * 8 <= s.bitCount;
+}
+}  // namespace
+
+bool fastInflate(const uint8_t* input, const size_t inputSize, uint8_t* output, const size_t outputSize) {
+  const auto state = static_cast<FastInflateState*>(malloc(sizeof(FastInflateState)));
+  if (!state) {
+    Serial.printf("[%lu] [ZIP] Failed to allocate memory for fast inflate tables\n", millis());
+    return false;
+  }
+
+  state->bits.in = input;
+  state->bits.inEnd = input + inputSize;
+  state->bits.bitBuffer = 0;
+  state->bits.bitCount = 0;
+  state->bits.overrun = 0;
+  state->fixedTablesBuilt = false;
+
+  const bool success = inflateBlocks(*state, output, outputSize);
+  free(state);
+  return success;
+}
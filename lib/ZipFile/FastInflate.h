@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Table driven raw deflate decoder for inflating a whole entry into a single, non-wrapping output buffer.
+ *
+ * Literal/length codes are decoded through a 10 bit lookup table where short literal pairs resolve in a single lookup,
+ * input is refilled a word at a time and matches are copied a word at a time where they do not overlap.
+ *
+ * Only used when built with ZIP_FAST_INFLATE, streaming reads stay on tinfl as they need a resumable inflator.
+ * Returns false if the stream is invalid or does not inflate to exactly outputSize bytes.
+ */
+bool fastInflate(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize);
@@ -0,0 +1,383 @@
+#include "ZipEntryReader.h"
+
+#include <HardwareSerial.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+constexpr uint8_t INFLATE_CHECKPOINT_FILE_VERSION = 1;
+// version, decompressor size, data offset, compressed size, inflated size, interval, checkpoint count
+constexpr size_t INFLATE_CHECKPOINT_HEADER_SIZE = sizeof(uint8_t) + 6 * sizeof(uint32_t);
+constexpr size_t INFLATE_CHECKPOINT_COUNT_OFFSET = INFLATE_CHECKPOINT_HEADER_SIZE - sizeof(uint32_t);
+
+// Fixed size checkpoint record, followed by the raw decompressor state and the full dictionary.
+// tinfl does not surface deflate block boundaries, so the decompressor (including its Huffman tables) is captured
+// between calls instead, which lets it resume from any point in the stream.
+struct InflateCheckpoint {
+  uint32_t outputOffset;
+  uint32_t compressedOffset;
+  uint32_t dictionaryCursor;
+  int32_t status;
+};
+static_assert(sizeof(InflateCheckpoint) == 16, "InflateCheckpoint must be tightly packed");
+constexpr size_t INFLATE_CHECKPOINT_RECORD_SIZE =
+    sizeof(InflateCheckpoint) + sizeof(tinfl_decompressor) + TINFL_LZ_DICT_SIZE;
+}  // namespace
+
+ZipEntryReader::~ZipEntryReader() {
+  finishCheckpoints();
+  free(dictionary);
+  free(fileReadBuffer);
+  free(inflator);
+}
+
+bool ZipEntryReader::setup() {
+  if (method == MZ_NO_COMPRESSION) {
+    // Stored entries are read straight into the consumer's buffer
+    return true;
+  }
+
+  if (method != MZ_DEFLATED) {
+    Serial.printf("[%lu] [ZER] Unsupported compression method\n", millis());
+    return false;
+  }
+
+  inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
+  if (!inflator) {
+    Serial.printf("[%lu] [ZER] Failed to allocate memory for inflator\n", millis());
+    return false;
+  }
+
+  fileReadBuffer = static_cast<uint8_t*>(malloc(chunkSize));
+  if (!fileReadBuffer) {
+    Serial.printf("[%lu] [ZER] Failed to allocate memory for zip file read buffer\n", millis());
+    return false;
+  }
+
+  dictionary = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+  if (!dictionary) {
+    Serial.printf("[%lu] [ZER] Failed to allocate memory for dictionary\n", millis());
+    return false;
+  }
+
+  resetInflator();
+  return true;
+}
+
+void ZipEntryReader::resetInflator() {
+  memset(inflator, 0, sizeof(tinfl_decompressor));
+  tinfl_init(inflator);
+  memset(dictionary, 0, TINFL_LZ_DICT_SIZE);
+
+  inflatorStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+  compressedRead = 0;
+  inflatedRead = 0;
+  failed = false;
+  fileReadBufferFilledBytes = 0;
+  fileReadBufferCursor = 0;
+  dictionaryCursor = 0;
+  pendingOutputStart = 0;
+  pendingOutputBytes = 0;
+}
+
+size_t ZipEntryReader::read(uint8_t* buffer, const size_t size) {
+  if (failed || size == 0 || eof()) {
+    return 0;
+  }
+
+  const size_t bytesRead = method == MZ_NO_COMPRESSION ? readStored(buffer, size) : readDeflated(buffer, size);
+  inflatedRead += bytesRead;
+  return bytesRead;
+}
+
+void ZipEntryReader::positionArchive() const {
+  // The archive handle is shared with other readers, only seek when someone else moved it as seeking drops the
+  // stdio buffer
+  const long target = static_cast<long>(dataOffset + compressedRead);
+  if (ftell(file) != target) {
+    fseek(file, target, SEEK_SET);
+  }
+}
+
+size_t ZipEntryReader::readStored(uint8_t* buffer, const size_t size) {
+  const size_t remaining = inflatedSize - inflatedRead;
+  const size_t toRead = remaining < size ? remaining : size;
+
+  positionArchive();
+  const size_t dataRead = fread(buffer, 1, toRead, file);
+  compressedRead += dataRead;
+
+  if (dataRead != toRead) {
+    Serial.printf("[%lu] [ZER] Could not read more bytes\n", millis());
+    failed = true;
+  }
+  return dataRead;
+}
+
+bool ZipEntryReader::fillFileReadBuffer() {
+  const size_t fileRemainingBytes = compressedSize - compressedRead;
+  if (fileRemainingBytes == 0) {
+    return false;
+  }
+
+  positionArchive();
+  fileReadBufferFilledBytes =
+      fread(fileReadBuffer, 1, fileRemainingBytes < chunkSize ? fileRemainingBytes : chunkSize, file);
+  fileReadBufferCursor = 0;
+  compressedRead += fileReadBufferFilledBytes;
+
+  return fileReadBufferFilledBytes > 0;
+}
+
+size_t ZipEntryReader::readDeflated(uint8_t* buffer, const size_t size) {
+  size_t bytesRead = 0;
+
+  while (bytesRead < size) {
+    // Hand out anything already inflated into the dictionary first
+    if (pendingOutputBytes > 0) {
+      const size_t toCopy = pendingOutputBytes < size - bytesRead ? pendingOutputBytes : size - bytesRead;
+      memcpy(buffer + bytesRead, dictionary + pendingOutputStart, toCopy);
+      pendingOutputStart += toCopy;
+      pendingOutputBytes -= toCopy;
+      bytesRead += toCopy;
+      continue;
+    }
+
+    if (inflatorStatus == TINFL_STATUS_DONE) {
+      break;
+    }
+
+    // Everything inflated so far has been handed out, so the inflator can be resumed from here
+    if (checkpointFile && inflatedRead + bytesRead >= nextCheckpointOffset) {
+      writeCheckpoint(inflatedRead + bytesRead);
+    }
+
+    // Load more compressed bytes when needed
+    if (fileReadBufferCursor >= fileReadBufferFilledBytes && !fillFileReadBuffer()) {
+      if (inflatorStatus == TINFL_STATUS_NEEDS_MORE_INPUT) {
+        Serial.printf("[%lu] [ZER] Unexpected EOF\n", millis());
+        failed = true;
+        break;
+      }
+    }
+
+    // Available bytes in fileReadBuffer to process
+    size_t inBytes = fileReadBufferFilledBytes - fileReadBufferCursor;
+    // Space remaining in the dictionary
+    size_t outBytes = TINFL_LZ_DICT_SIZE - dictionaryCursor;
+
+    inflatorStatus = tinfl_decompress(inflator, fileReadBuffer + fileReadBufferCursor, &inBytes, dictionary,
+                                      dictionary + dictionaryCursor, &outBytes,
+                                      compressedRead < compressedSize ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+
+    fileReadBufferCursor += inBytes;
+    pendingOutputStart = dictionaryCursor;
+    pendingOutputBytes = outBytes;
+    // Update output position in the dictionary (with wraparound)
+    dictionaryCursor = (dictionaryCursor + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+    if (inflatorStatus < 0) {
+      Serial.printf("[%lu] [ZER] tinfl_decompress() failed with status %d\n", millis(), inflatorStatus);
+      failed = true;
+      break;
+    }
+  }
+
+  return bytesRead;
+}
+
+bool ZipEntryReader::skip(size_t size) {
+  uint8_t buffer[256];
+  while (size > 0) {
+    const size_t bytesRead = read(buffer, size < sizeof(buffer) ? size : sizeof(buffer));
+    if (bytesRead == 0) {
+      return false;
+    }
+    size -= bytesRead;
+  }
+  return true;
+}
+
+bool ZipEntryReader::recordCheckpoints(const std::string& checkpointPath, const size_t interval) {
+  if (method != MZ_DEFLATED || inflatedSize <= interval || interval == 0) {
+    return true;
+  }
+
+  if (inflatedRead != 0 || checkpointFile) {
+    Serial.printf("[%lu] [ZER] Checkpoints must be recorded from the start of the entry\n", millis());
+    return false;
+  }
+
+  checkpointFile = fopen(checkpointPath.c_str(), "wb");
+  if (!checkpointFile) {
+    Serial.printf("[%lu] [ZER] Could not open checkpoint file %s\n", millis(), checkpointPath.c_str());
+    return false;
+  }
+
+  const uint32_t decompressorSize = sizeof(tinfl_decompressor);
+  const uint32_t checkpointIntervalValue = interval;
+  checkpointCount = 0;
+  const bool success =
+      fwrite(&INFLATE_CHECKPOINT_FILE_VERSION, sizeof(INFLATE_CHECKPOINT_FILE_VERSION), 1, checkpointFile) == 1 &&
+      fwrite(&decompressorSize, sizeof(decompressorSize), 1, checkpointFile) == 1 &&
+      fwrite(&dataOffset, sizeof(dataOffset), 1, checkpointFile) == 1 &&
+      fwrite(&compressedSize, sizeof(compressedSize), 1, checkpointFile) == 1 &&
+      fwrite(&inflatedSize, sizeof(inflatedSize), 1, checkpointFile) == 1 &&
+      fwrite(&checkpointIntervalValue, sizeof(checkpointIntervalValue), 1, checkpointFile) == 1 &&
+      fwrite(&checkpointCount, sizeof(checkpointCount), 1, checkpointFile) == 1;
+  if (!success) {
+    Serial.printf("[%lu] [ZER] Could not write checkpoint file header\n", millis());
+    fclose(checkpointFile);
+    checkpointFile = nullptr;
+    return false;
+  }
+
+  checkpointInterval = interval;
+  nextCheckpointOffset = interval;
+  return true;
+}
+
+void ZipEntryReader::writeCheckpoint(const size_t outputOffset) {
+  InflateCheckpoint checkpoint;
+  checkpoint.outputOffset = outputOffset;
+  // Bytes still waiting in the read buffer have not been consumed by the inflator yet
+  checkpoint.compressedOffset = compressedRead - (fileReadBufferFilledBytes - fileReadBufferCursor);
+  checkpoint.dictionaryCursor = dictionaryCursor;
+  checkpoint.status = inflatorStatus;
+
+  const bool success = fwrite(&checkpoint, sizeof(checkpoint), 1, checkpointFile) == 1 &&
+                       fwrite(inflator, sizeof(tinfl_decompressor), 1, checkpointFile) == 1 &&
+                       fwrite(dictionary, 1, TINFL_LZ_DICT_SIZE, checkpointFile) == TINFL_LZ_DICT_SIZE;
+  if (!success) {
+    // Keep the checkpoints written so far and stop recording
+    Serial.printf("[%lu] [ZER] Could not write checkpoint at %u\n", millis(), checkpoint.outputOffset);
+    finishCheckpoints();
+    return;
+  }
+
+  checkpointCount++;
+  nextCheckpointOffset = outputOffset + checkpointInterval;
+
+  // The record goes to SD before the count that covers it, so checkpoints taken before an interrupted read (power
+  // loss, a crash) can still be resumed from
+  const long end = ftell(checkpointFile);
+  fflush(checkpointFile);
+  fsync(fileno(checkpointFile));
+  fseek(checkpointFile, INFLATE_CHECKPOINT_COUNT_OFFSET, SEEK_SET);
+  fwrite(&checkpointCount, sizeof(checkpointCount), 1, checkpointFile);
+  fseek(checkpointFile, end, SEEK_SET);
+  fflush(checkpointFile);
+  fsync(fileno(checkpointFile));
+}
+
+void ZipEntryReader::finishCheckpoints() {
+  if (!checkpointFile) {
+    return;
+  }
+
+  // Only complete records are counted, so a partially recorded file is still usable
+  fseek(checkpointFile, INFLATE_CHECKPOINT_COUNT_OFFSET, SEEK_SET);
+  fwrite(&checkpointCount, sizeof(checkpointCount), 1, checkpointFile);
+  fclose(checkpointFile);
+  checkpointFile = nullptr;
+  Serial.printf("[%lu] [ZER] Recorded %u inflate checkpoints\n", millis(), checkpointCount);
+}
+
+bool ZipEntryReader::restoreCheckpoint(const std::string& checkpointPath, const size_t offset) {
+  FILE* in = fopen(checkpointPath.c_str(), "rb");
+  if (!in) {
+    return false;
+  }
+
+  uint8_t version;
+  uint32_t decompressorSize, fileDataOffset, fileCompressedSize, fileInflatedSize, interval, count;
+  const bool headerValid =
+      fread(&version, sizeof(version), 1, in) == 1 && fread(&decompressorSize, sizeof(decompressorSize), 1, in) == 1 &&
+      fread(&fileDataOffset, sizeof(fileDataOffset), 1, in) == 1 &&
+      fread(&fileCompressedSize, sizeof(fileCompressedSize), 1, in) == 1 &&
+      fread(&fileInflatedSize, sizeof(fileInflatedSize), 1, in) == 1 &&
+      fread(&interval, sizeof(interval), 1, in) == 1 && fread(&count, sizeof(count), 1, in) == 1 &&
+      version == INFLATE_CHECKPOINT_FILE_VERSION && decompressorSize == sizeof(tinfl_decompressor) &&
+      fileDataOffset == dataOffset && fileCompressedSize == compressedSize && fileInflatedSize == inflatedSize &&
+      interval > 0;
+  if (!headerValid) {
+    Serial.printf("[%lu] [ZER] Checkpoint file does not match entry, ignoring\n", millis());
+    fclose(in);
+    return false;
+  }
+
+  // Checkpoints are recorded in order, roughly every interval bytes, so start from the estimate and walk back
+  uint32_t checkpointIndex = offset / interval;
+  if (checkpointIndex > count) {
+    checkpointIndex = count;
+  }
+
+  InflateCheckpoint checkpoint = {};
+  bool found = false;
+  while (checkpointIndex > 0) {
+    checkpointIndex--;
+    fseek(in, INFLATE_CHECKPOINT_HEADER_SIZE + checkpointIndex * INFLATE_CHECKPOINT_RECORD_SIZE, SEEK_SET);
+    if (fread(&checkpoint, sizeof(checkpoint), 1, in) != 1) {
+      break;
+    }
+    if (checkpoint.outputOffset <= offset) {
+      found = true;
+      break;
+    }
+  }
+
+  // Resuming only helps if the checkpoint is ahead of where the reader already is
+  if (!found || (checkpoint.outputOffset <= inflatedRead && inflatedRead <= offset)) {
+    fclose(in);
+    return false;
+  }
+
+  const bool success = fread(inflator, sizeof(tinfl_decompressor), 1, in) == 1 &&
+                       fread(dictionary, 1, TINFL_LZ_DICT_SIZE, in) == TINFL_LZ_DICT_SIZE;
+  fclose(in);
+  if (!success) {
+    Serial.printf("[%lu] [ZER] Could not read checkpoint state\n", millis());
+    resetInflator();
+    return false;
+  }
+
+  inflatorStatus = static_cast<tinfl_status>(checkpoint.status);
+  compressedRead = checkpoint.compressedOffset;
+  inflatedRead = checkpoint.outputOffset;
+  failed = false;
+  fileReadBufferFilledBytes = 0;
+  fileReadBufferCursor = 0;
+  dictionaryCursor = checkpoint.dictionaryCursor;
+  pendingOutputStart = dictionaryCursor;
+  pendingOutputBytes = 0;
+  return true;
+}
+
+bool ZipEntryReader::seek(const size_t offset, const std::string& checkpointPath) {
+  if (offset > inflatedSize) {
+    return false;
+  }
+
+  if (checkpointFile) {
+    Serial.printf("[%lu] [ZER] Cannot seek while recording checkpoints\n", millis());
+    return false;
+  }
+
+  if (method == MZ_NO_COMPRESSION) {
+    compressedRead = offset;
+    inflatedRead = offset;
+    failed = false;
+    return true;
+  }
+
+  if (checkpointPath.empty() || !restoreCheckpoint(checkpointPath, offset)) {
+    if (offset < inflatedRead) {
+      // No usable checkpoint behind the target, inflate again from the start
+      resetInflator();
+    }
+  }
+
+  return skip(offset - inflatedRead);
+}
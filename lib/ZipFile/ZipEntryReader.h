@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "miniz.h"
+
+/**
+ * Pull based reader for a single entry in a zip archive.
+ *
+ * Deflated entries are inflated on demand, keeping the inflator state and the 32KB dictionary between calls to read,
+ * so consumers can decompress straight into their own buffers. Stored entries are read directly from the archive.
+ *
+ * While a deflated entry is read for the first time, inflate checkpoints can be recorded every N bytes of output.
+ * Each checkpoint is a snapshot of the inflator and its dictionary, so a later reader can seek to an inflated offset by
+ * resuming from the nearest checkpoint instead of inflating from the start of the entry.
+ *
+ * The reader borrows the archive handle of the ZipFile that opened it and must not outlive it.
+ */
+class ZipEntryReader {
+  FILE* file;
+  uint32_t dataOffset;
+  uint32_t compressedSize;
+  uint32_t inflatedSize;
+  uint16_t method;
+  size_t chunkSize;
+
+  // Compressed bytes pulled from the archive so far
+  size_t compressedRead = 0;
+  // Inflated bytes handed out to the consumer so far
+  size_t inflatedRead = 0;
+  bool failed = false;
+
+  tinfl_decompressor* inflator = nullptr;
+  tinfl_status inflatorStatus = TINFL_STATUS_NEEDS_MORE_INPUT;
+  uint8_t* fileReadBuffer = nullptr;
+  size_t fileReadBufferFilledBytes = 0;
+  size_t fileReadBufferCursor = 0;
+  uint8_t* dictionary = nullptr;
+  // Current offset in the circular dictionary
+  size_t dictionaryCursor = 0;
+  // Inflated bytes in the dictionary that have not been handed out yet
+  size_t pendingOutputStart = 0;
+  size_t pendingOutputBytes = 0;
+
+  // Checkpoints being recorded while the entry is read, see recordCheckpoints
+  FILE* checkpointFile = nullptr;
+  size_t checkpointInterval = 0;
+  size_t nextCheckpointOffset = 0;
+  uint32_t checkpointCount = 0;
+
+  void positionArchive() const;
+  size_t readStored(uint8_t* buffer, size_t size);
+  size_t readDeflated(uint8_t* buffer, size_t size);
+  bool fillFileReadBuffer();
+  void resetInflator();
+  void writeCheckpoint(size_t outputOffset);
+  void finishCheckpoints();
+  bool restoreCheckpoint(const std::string& checkpointPath, size_t offset);
+  bool skip(size_t size);
+
+ public:
+  explicit ZipEntryReader(FILE* file, uint32_t dataOffset, uint32_t compressedSize, uint32_t inflatedSize,
+                          uint16_t method, size_t chunkSize)
+      : file(file),
+        dataOffset(dataOffset),
+        compressedSize(compressedSize),
+        inflatedSize(inflatedSize),
+        method(method),
+        chunkSize(chunkSize) {}
+  ~ZipEntryReader();
+  ZipEntryReader(const ZipEntryReader&) = delete;
+  ZipEntryReader& operator=(const ZipEntryReader&) = delete;
+
+  bool setup();
+  // Reads up to size inflated bytes into buffer, returns 0 once the entry is exhausted or on error
+  size_t read(uint8_t* buffer, size_t size);
+  size_t size() const { return inflatedSize; }
+  size_t position() const { return inflatedRead; }
+  bool eof() const { return inflatedRead >= inflatedSize; }
+  bool hasFailed() const { return failed; }
+
+  // Starts recording inflate checkpoints to checkpointPath every interval inflated bytes, only valid before the first
+  // read. Entries that are stored or smaller than the interval are not worth checkpointing and are skipped.
+  bool recordCheckpoints(const std::string& checkpointPath, size_t interval);
+  // Moves to the given inflated offset, resuming from the nearest usable checkpoint in checkpointPath if there is one
+  bool seek(size_t offset, const std::string& checkpointPath = "");
+};
@@ -2,8 +2,21 @@
 
 #include <HardwareSerial.h>
 #include <miniz.h>
+#include <strings.h>
+
+#include <algorithm>
+
+#include "FastInflate.h"
 
 bool inflateOneShot(const uint8_t* inputBuf, const size_t deflatedSize, uint8_t* outputBuf, const size_t inflatedSize) {
+#ifdef ZIP_FAST_INFLATE
+  if (fastInflate(inputBuf, deflatedSize, outputBuf, inflatedSize)) {
+    return true;
+  }
+  // Streams the table driven decoder can't handle are retried with tinfl below
+  Serial.printf("[%lu] [ZIP] Fast inflate failed, falling back to tinfl\n", millis());
+#endif
+
   // Setup inflator
   const auto inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
   if (!inflator) {
@@ -27,104 +40,548 @@ bool inflateOneShot(const uint8_t* inputBuf, const size_t deflatedSize, uint8_t*
   return true;
 }
 
-ZipFile::ZipFile(std::string filePath) : filePath(std::move(filePath)) {
-  const bool status = mz_zip_reader_init_file(&zipArchive, this->filePath.c_str(), 0);
+namespace {
+constexpr uint8_t ZIP_INDEX_FILE_VERSION = 1;
+constexpr size_t ZIP_INDEX_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+constexpr auto localHeaderSize = 30;
+constexpr auto centralHeaderSize = 46;
+constexpr auto endOfCentralDirSize = 22;
+// Only trailing comments up to this size are searched for the end of central directory record
+constexpr auto endOfCentralDirSearchSize = 1024;
+
+uint16_t readLe16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+uint32_t readLe32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+// Fixed size record in the index file, records are sorted by name so they can be binary searched straight from SD.
+// Names live in a pool after the records, stored in the same order as the records.
+struct ZipIndexRecord {
+  uint32_t nameOffset;
+  uint16_t nameLength;
+  uint16_t method;
+  uint32_t localHeaderOffset;
+  uint32_t dataOffset;
+  uint32_t compressedSize;
+  uint32_t inflatedSize;
+};
+static_assert(sizeof(ZipIndexRecord) == 24, "ZipIndexRecord must be tightly packed");
+
+long readDataOffset(FILE* file, const uint32_t localHeaderOffset) {
+  uint8_t pLocalHeader[localHeaderSize];
 
-  if (!status) {
-    Serial.printf("[%lu] [ZIP] mz_zip_reader_init_file() failed for %s! Error: %s\n", millis(), this->filePath.c_str(),
-                  mz_zip_get_error_string(zipArchive.m_last_error));
+  fseek(file, localHeaderOffset, SEEK_SET);
+  const size_t read = fread(pLocalHeader, 1, localHeaderSize, file);
+
+  if (read != localHeaderSize) {
+    Serial.printf("[%lu] [ZIP] Something went wrong reading the local header\n", millis());
+    return -1;
+  }
+
+  if (pLocalHeader[0] + (pLocalHeader[1] << 8) + (pLocalHeader[2] << 16) + (pLocalHeader[3] << 24) !=
+      0x04034b50 /* MZ_ZIP_LOCAL_DIR_HEADER_SIG */) {
+    Serial.printf("[%lu] [ZIP] Not a valid zip file header\n", millis());
+    return -1;
   }
+
+  const uint16_t filenameLength = pLocalHeader[26] + (pLocalHeader[27] << 8);
+  const uint16_t extraOffset = pLocalHeader[28] + (pLocalHeader[29] << 8);
+  return localHeaderOffset + localHeaderSize + filenameLength + extraOffset;
 }
 
-bool ZipFile::loadFileStat(const char* filename, mz_zip_archive_file_stat* fileStat) const {
-  // find the file
-  mz_uint32 fileIndex = 0;
-  if (!mz_zip_reader_locate_file_v2(&zipArchive, filename, nullptr, 0, &fileIndex)) {
-    Serial.printf("[%lu] [ZIP] Could not find file %s\n", millis(), filename);
+bool readIndexRecord(FILE* indexFile, const uint32_t recordIndex, ZipIndexRecord* record) {
+  fseek(indexFile, ZIP_INDEX_HEADER_SIZE + recordIndex * sizeof(ZipIndexRecord), SEEK_SET);
+  return fread(record, sizeof(ZipIndexRecord), 1, indexFile) == 1;
+}
+
+bool readIndexName(FILE* indexFile, const uint32_t entryCount, const ZipIndexRecord& record, std::string* name) {
+  name->resize(record.nameLength);
+  fseek(indexFile, ZIP_INDEX_HEADER_SIZE + entryCount * sizeof(ZipIndexRecord) + record.nameOffset, SEEK_SET);
+  return fread(&(*name)[0], 1, record.nameLength, indexFile) == record.nameLength;
+}
+
+// Binary search over the sorted records
+bool findIndexRecord(FILE* indexFile, const uint32_t entryCount, const char* filename, ZipIndexRecord* record) {
+  const size_t filenameLength = strlen(filename);
+  std::string name;
+  uint32_t low = 0;
+  uint32_t high = entryCount;
+  while (low < high) {
+    const uint32_t mid = low + (high - low) / 2;
+    if (!readIndexRecord(indexFile, mid, record) || !readIndexName(indexFile, entryCount, *record, &name)) {
+      Serial.printf("[%lu] [ZIP] Failed to read index record %u\n", millis(), mid);
+      return false;
+    }
+
+    const int cmp = name.compare(0, name.size(), filename, filenameLength);
+    if (cmp == 0) {
+      return true;
+    }
+
+    if (cmp < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  Serial.printf("[%lu] [ZIP] Could not find file %s\n", millis(), filename);
+  return false;
+}
+}  // namespace
+
+ZipFile::ZipFile(std::string filePath, std::string indexPath)
+    : filePath(std::move(filePath)), indexPath(std::move(indexPath)) {}
+
+ZipFile::~ZipFile() {
+  if (zipArchiveInitialised) {
+    mz_zip_reader_end(&zipArchive);
+  }
+  if (file) {
+    fclose(file);
+  }
+}
+
+bool ZipFile::openArchive() const {
+  if (file) {
+    return true;
+  }
+
+  file = fopen(filePath.c_str(), "rb");
+  if (!file) {
+    Serial.printf("[%lu] [ZIP] Failed to open %s\n", millis(), filePath.c_str());
     return false;
   }
 
-  if (!mz_zip_reader_file_stat(&zipArchive, fileIndex, fileStat)) {
-    Serial.printf("[%lu] [ZIP] mz_zip_reader_file_stat() failed! Error: %s\n", millis(),
+  fseek(file, 0, SEEK_END);
+  archiveSize = ftell(file);
+  return true;
+}
+
+bool ZipFile::getArchiveSize(size_t* size) const {
+  if (!openArchive()) {
+    return false;
+  }
+
+  *size = archiveSize;
+  return true;
+}
+
+void ZipFile::setIndexPath(std::string indexPath) {
+  this->indexPath = std::move(indexPath);
+  indexChecked = false;
+}
+
+bool ZipFile::readTrailer(ZipFingerprint* fingerprint) const {
+  if (!openArchive()) {
+    return false;
+  }
+
+  const long searchSize = std::min<long>(archiveSize, endOfCentralDirSearchSize + endOfCentralDirSize);
+  if (searchSize < endOfCentralDirSize) {
+    Serial.printf("[%lu] [ZIP] %s is too small to be a zip file\n", millis(), filePath.c_str());
+    return false;
+  }
+
+  const auto buffer = static_cast<uint8_t*>(malloc(searchSize));
+  if (!buffer) {
+    Serial.printf("[%lu] [ZIP] Failed to allocate memory for trailer\n", millis());
+    return false;
+  }
+
+  fseek(file, archiveSize - searchSize, SEEK_SET);
+  const bool read = fread(buffer, 1, searchSize, file) == static_cast<size_t>(searchSize);
+
+  // Search backwards as the record is followed by a variable length comment
+  bool found = false;
+  for (long i = searchSize - endOfCentralDirSize; read && i >= 0; i--) {
+    if (readLe32(buffer + i) == 0x06054b50 /* MZ_ZIP_END_OF_CENTRAL_DIR_HEADER_SIG */) {
+      fingerprint->archiveSize = archiveSize;
+      fingerprint->trailerCrc = mz_crc32(MZ_CRC32_INIT, buffer, searchSize);
+      fingerprint->centralDirectorySize = readLe32(buffer + i + 12);
+      fingerprint->centralDirectoryOffset = readLe32(buffer + i + 16);
+      found = true;
+      break;
+    }
+  }
+  free(buffer);
+
+  if (!found || static_cast<long>(fingerprint->centralDirectoryOffset) + fingerprint->centralDirectorySize >
+                    archiveSize) {
+    Serial.printf("[%lu] [ZIP] Could not find end of central directory in %s\n", millis(), filePath.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool ZipFile::getFingerprint(ZipFingerprint* fingerprint) const {
+  if (!readTrailer(fingerprint)) {
+    return false;
+  }
+
+  const auto start = millis();
+  uint8_t buffer[256];
+  uint32_t crc = MZ_CRC32_INIT;
+  uint32_t remaining = fingerprint->centralDirectorySize;
+  bool opfFound = false;
+  fingerprint->opfCrc = 0;
+
+  // Walk the records so the OPF entry can be picked out while every byte goes through the CRC
+  fseek(file, fingerprint->centralDirectoryOffset, SEEK_SET);
+  while (remaining >= centralHeaderSize) {
+    if (fread(buffer, 1, centralHeaderSize, file) != centralHeaderSize ||
+        readLe32(buffer) != 0x02014b50 /* MZ_ZIP_CENTRAL_DIR_HEADER_SIG */) {
+      Serial.printf("[%lu] [ZIP] Invalid central directory record\n", millis());
+      return false;
+    }
+    crc = mz_crc32(crc, buffer, centralHeaderSize);
+    remaining -= centralHeaderSize;
+
+    const uint32_t entryCrc = readLe32(buffer + 16);
+    const uint16_t nameLength = readLe16(buffer + 28);
+    uint32_t trailingLength = readLe16(buffer + 30) + readLe16(buffer + 32);
+    if (nameLength + trailingLength > remaining) {
+      Serial.printf("[%lu] [ZIP] Central directory record overruns directory\n", millis());
+      return false;
+    }
+
+    // Names are read in buffer sized pieces, only the tail matters for spotting .opf
+    uint32_t nameRemaining = nameLength;
+    char nameTail[4] = {};
+    while (nameRemaining > 0) {
+      const size_t pieceLength = std::min<uint32_t>(nameRemaining, sizeof(buffer));
+      if (fread(buffer, 1, pieceLength, file) != pieceLength) {
+        return false;
+      }
+      crc = mz_crc32(crc, buffer, pieceLength);
+      for (size_t i = 0; i < pieceLength; i++) {
+        memmove(nameTail, nameTail + 1, sizeof(nameTail) - 1);
+        nameTail[sizeof(nameTail) - 1] = static_cast<char>(buffer[i]);
+      }
+      nameRemaining -= pieceLength;
+    }
+    remaining -= nameLength;
+    if (!opfFound && nameLength >= 4 && strncasecmp(nameTail, ".opf", 4) == 0) {
+      fingerprint->opfCrc = entryCrc;
+      opfFound = true;
+    }
+
+    remaining -= trailingLength;
+    while (trailingLength > 0) {
+      const size_t pieceLength = std::min<uint32_t>(trailingLength, sizeof(buffer));
+      if (fread(buffer, 1, pieceLength, file) != pieceLength) {
+        return false;
+      }
+      crc = mz_crc32(crc, buffer, pieceLength);
+      trailingLength -= pieceLength;
+    }
+  }
+
+  fingerprint->centralDirectoryCrc = crc;
+  Serial.printf("[%lu] [ZIP] Fingerprinted %u byte central directory in %lums\n", millis(),
+                fingerprint->centralDirectorySize, millis() - start);
+  return true;
+}
+
+bool ZipFile::initZipArchive() const {
+  if (zipArchiveInitialised) {
+    return true;
+  }
+
+  if (!openArchive()) {
+    return false;
+  }
+
+  // Share the already open handle rather than letting miniz open the archive a second time
+  fseek(file, 0, SEEK_SET);
+  if (!mz_zip_reader_init_cfile(&zipArchive, file, archiveSize, 0)) {
+    Serial.printf("[%lu] [ZIP] mz_zip_reader_init_cfile() failed for %s! Error: %s\n", millis(), filePath.c_str(),
                   mz_zip_get_error_string(zipArchive.m_last_error));
     return false;
   }
+
+  zipArchiveInitialised = true;
   return true;
 }
 
-long ZipFile::getDataOffset(const mz_zip_archive_file_stat& fileStat) const {
-  constexpr auto localHeaderSize = 30;
+bool ZipFile::openIndex() const {
+  if (indexChecked) {
+    return indexUsable;
+  }
+  indexChecked = true;
 
-  uint8_t pLocalHeader[localHeaderSize];
-  const uint64_t fileOffset = fileStat.m_local_header_ofs;
+  if (indexPath.empty()) {
+    return false;
+  }
 
-  FILE* file = fopen(filePath.c_str(), "r");
-  if (!file) {
-    Serial.printf("[%lu] [ZIP] Failed to open file for reading local header\n", millis());
-    return -1;
+  if (!openArchive()) {
+    return false;
   }
-  fseek(file, fileOffset, SEEK_SET);
-  const size_t read = fread(pLocalHeader, 1, localHeaderSize, file);
-  fclose(file);
 
-  if (read != localHeaderSize) {
-    Serial.printf("[%lu] [ZIP] Something went wrong reading the local header\n", millis());
-    return -1;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    FILE* indexFile = fopen(indexPath.c_str(), "rb");
+    if (indexFile) {
+      uint8_t version = 0;
+      uint32_t indexedArchiveSize = 0;
+      indexUsable = fread(&version, sizeof(version), 1, indexFile) == 1 &&
+                    fread(&indexedArchiveSize, sizeof(indexedArchiveSize), 1, indexFile) == 1 &&
+                    fread(&indexEntryCount, sizeof(indexEntryCount), 1, indexFile) == 1 &&
+                    version == ZIP_INDEX_FILE_VERSION && indexedArchiveSize == static_cast<uint32_t>(archiveSize);
+      fclose(indexFile);
+      if (indexUsable) {
+        return true;
+      }
+
+      Serial.printf("[%lu] [ZIP] Index is stale or unreadable, rebuilding\n", millis());
+    }
+
+    if (attempt == 0 && !buildIndex()) {
+      return false;
+    }
   }
 
-  if (pLocalHeader[0] + (pLocalHeader[1] << 8) + (pLocalHeader[2] << 16) + (pLocalHeader[3] << 24) !=
-      0x04034b50 /* MZ_ZIP_LOCAL_DIR_HEADER_SIG */) {
-    Serial.printf("[%lu] [ZIP] Not a valid zip file header\n", millis());
-    return -1;
+  return false;
+}
+
+bool ZipFile::buildIndex() const {
+  if (!initZipArchive()) {
+    return false;
   }
 
-  const uint16_t filenameLength = pLocalHeader[26] + (pLocalHeader[27] << 8);
-  const uint16_t extraOffset = pLocalHeader[28] + (pLocalHeader[29] << 8);
-  return fileOffset + localHeaderSize + filenameLength + extraOffset;
+  const auto start = millis();
+  const mz_uint fileCount = mz_zip_reader_get_num_files(&zipArchive);
+  std::vector<std::pair<std::string, ZipIndexRecord>> entries;
+  entries.reserve(fileCount);
+
+  for (mz_uint i = 0; i < fileCount; i++) {
+    mz_zip_archive_file_stat fileStat;
+    if (!mz_zip_reader_file_stat(&zipArchive, i, &fileStat) || fileStat.m_is_directory) {
+      continue;
+    }
+
+    const long dataOffset = readDataOffset(file, fileStat.m_local_header_ofs);
+    if (dataOffset < 0) {
+      continue;
+    }
+
+    ZipIndexRecord record = {};
+    record.method = fileStat.m_method;
+    record.localHeaderOffset = static_cast<uint32_t>(fileStat.m_local_header_ofs);
+    record.dataOffset = static_cast<uint32_t>(dataOffset);
+    record.compressedSize = static_cast<uint32_t>(fileStat.m_comp_size);
+    record.inflatedSize = static_cast<uint32_t>(fileStat.m_uncomp_size);
+    entries.emplace_back(fileStat.m_filename, record);
+  }
+
+  // The index replaces the central directory, so release it now
+  mz_zip_reader_end(&zipArchive);
+  zipArchiveInitialised = false;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<std::string, ZipIndexRecord>& a, const std::pair<std::string, ZipIndexRecord>& b) {
+              return a.first < b.first;
+            });
+
+  FILE* out = fopen(indexPath.c_str(), "wb");
+  if (!out) {
+    Serial.printf("[%lu] [ZIP] Failed to open index file for writing: %s\n", millis(), indexPath.c_str());
+    return false;
+  }
+
+  const uint32_t entryCount = entries.size();
+  const uint32_t indexedArchiveSize = archiveSize;
+  bool success = fwrite(&ZIP_INDEX_FILE_VERSION, sizeof(ZIP_INDEX_FILE_VERSION), 1, out) == 1 &&
+                 fwrite(&indexedArchiveSize, sizeof(indexedArchiveSize), 1, out) == 1 &&
+                 fwrite(&entryCount, sizeof(entryCount), 1, out) == 1;
+
+  uint32_t nameOffset = 0;
+  for (auto& entry : entries) {
+    entry.second.nameOffset = nameOffset;
+    entry.second.nameLength = static_cast<uint16_t>(entry.first.size());
+    nameOffset += entry.second.nameLength;
+    success = success && fwrite(&entry.second, sizeof(ZipIndexRecord), 1, out) == 1;
+  }
+  for (const auto& entry : entries) {
+    success = success && fwrite(entry.first.data(), 1, entry.first.size(), out) == entry.first.size();
+  }
+  fclose(out);
+
+  if (!success) {
+    Serial.printf("[%lu] [ZIP] Failed to write index file\n", millis());
+    remove(indexPath.c_str());
+    return false;
+  }
+
+  Serial.printf("[%lu] [ZIP] Indexed %u entries in %lums\n", millis(), entryCount, millis() - start);
+  return true;
+}
+
+bool ZipFile::loadFileStatFromIndex(const char* filename, FileStat* fileStat) const {
+  FILE* indexFile = fopen(indexPath.c_str(), "rb");
+  if (!indexFile) {
+    Serial.printf("[%lu] [ZIP] Failed to open index file: %s\n", millis(), indexPath.c_str());
+    return false;
+  }
+
+  ZipIndexRecord record;
+  const bool found = findIndexRecord(indexFile, indexEntryCount, filename, &record);
+  fclose(indexFile);
+  if (!found) {
+    return false;
+  }
+
+  fileStat->localHeaderOffset = record.localHeaderOffset;
+  fileStat->dataOffset = record.dataOffset;
+  fileStat->compressedSize = record.compressedSize;
+  fileStat->inflatedSize = record.inflatedSize;
+  fileStat->method = record.method;
+  return true;
+}
+
+bool ZipFile::loadFileStat(const char* filename, FileStat* fileStat) const {
+  const auto cached = fileStatCache.find(filename);
+  if (cached != fileStatCache.end()) {
+    *fileStat = cached->second;
+    return true;
+  }
+
+  if (openIndex()) {
+    if (!loadFileStatFromIndex(filename, fileStat)) {
+      return false;
+    }
+    fileStatCache.emplace(filename, *fileStat);
+    return true;
+  }
+
+  // No usable index, fall back to reading the central directory
+  if (!initZipArchive()) {
+    return false;
+  }
+
+  // find the file
+  mz_uint32 fileIndex = 0;
+  if (!mz_zip_reader_locate_file_v2(&zipArchive, filename, nullptr, 0, &fileIndex)) {
+    Serial.printf("[%lu] [ZIP] Could not find file %s\n", millis(), filename);
+    return false;
+  }
+
+  mz_zip_archive_file_stat mzFileStat;
+  if (!mz_zip_reader_file_stat(&zipArchive, fileIndex, &mzFileStat)) {
+    Serial.printf("[%lu] [ZIP] mz_zip_reader_file_stat() failed! Error: %s\n", millis(),
+                  mz_zip_get_error_string(zipArchive.m_last_error));
+    return false;
+  }
+
+  const long dataOffset = readDataOffset(file, mzFileStat.m_local_header_ofs);
+
+  if (dataOffset < 0) {
+    return false;
+  }
+
+  fileStat->localHeaderOffset = static_cast<uint32_t>(mzFileStat.m_local_header_ofs);
+  fileStat->dataOffset = static_cast<uint32_t>(dataOffset);
+  fileStat->compressedSize = static_cast<uint32_t>(mzFileStat.m_comp_size);
+  fileStat->inflatedSize = static_cast<uint32_t>(mzFileStat.m_uncomp_size);
+  fileStat->method = mzFileStat.m_method;
+  fileStatCache.emplace(filename, *fileStat);
+  return true;
 }
 
 bool ZipFile::getInflatedFileSize(const char* filename, size_t* size) const {
-  mz_zip_archive_file_stat fileStat;
+  FileStat fileStat;
   if (!loadFileStat(filename, &fileStat)) {
     return false;
   }
 
-  *size = static_cast<size_t>(fileStat.m_uncomp_size);
+  *size = static_cast<size_t>(fileStat.inflatedSize);
   return true;
 }
 
-uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const bool trailingNullByte) const {
-  mz_zip_archive_file_stat fileStat;
-  if (!loadFileStat(filename, &fileStat)) {
-    return nullptr;
+bool ZipFile::getInflatedFileSizes(const std::vector<std::string>& filenames, std::vector<size_t>& sizes) const {
+  sizes.assign(filenames.size(), 0);
+
+  if (!openIndex()) {
+    bool allFound = true;
+    for (size_t i = 0; i < filenames.size(); i++) {
+      allFound = getInflatedFileSize(filenames[i].c_str(), &sizes[i]) && allFound;
+    }
+    return allFound;
   }
 
-  const long fileOffset = getDataOffset(fileStat);
-  if (fileOffset < 0) {
-    return nullptr;
+  // Sort the requested names so they can be merged against the index in a single sequential pass
+  std::vector<size_t> order(filenames.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
   }
+  std::sort(order.begin(), order.end(),
+            [&filenames](const size_t a, const size_t b) { return filenames[a] < filenames[b]; });
+
+  // Records and names are read sequentially through two handles to avoid seeking back and forth
+  FILE* indexFile = fopen(indexPath.c_str(), "rb");
+  FILE* namesFile = fopen(indexPath.c_str(), "rb");
+  if (!indexFile || !namesFile) {
+    Serial.printf("[%lu] [ZIP] Failed to open index file: %s\n", millis(), indexPath.c_str());
+    if (indexFile) {
+      fclose(indexFile);
+    }
+    if (namesFile) {
+      fclose(namesFile);
+    }
+    return false;
+  }
+  fseek(indexFile, ZIP_INDEX_HEADER_SIZE, SEEK_SET);
+  fseek(namesFile, ZIP_INDEX_HEADER_SIZE + indexEntryCount * sizeof(ZipIndexRecord), SEEK_SET);
+
+  size_t found = 0;
+  size_t orderIndex = 0;
+  ZipIndexRecord record;
+  std::string name;
+  for (uint32_t i = 0; i < indexEntryCount && orderIndex < order.size(); i++) {
+    if (fread(&record, sizeof(record), 1, indexFile) != 1) {
+      break;
+    }
+    name.resize(record.nameLength);
+    if (fread(&name[0], 1, record.nameLength, namesFile) != record.nameLength) {
+      break;
+    }
 
-  FILE* file = fopen(filePath.c_str(), "rb");
-  if (!file) {
-    Serial.printf("[%lu] [ZIP] Failed to open file for reading\n", millis());
+    // Skip over any requested names that sort before this entry, they are not in the archive
+    while (orderIndex < order.size() && filenames[order[orderIndex]] < name) {
+      orderIndex++;
+    }
+    // The same name may have been requested more than once
+    while (orderIndex < order.size() && filenames[order[orderIndex]] == name) {
+      sizes[order[orderIndex]] = record.inflatedSize;
+      orderIndex++;
+      found++;
+    }
+  }
+  fclose(namesFile);
+  fclose(indexFile);
+
+  return found == filenames.size();
+}
+
+uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const bool trailingNullByte) const {
+  FileStat fileStat;
+  if (!loadFileStat(filename, &fileStat)) {
     return nullptr;
   }
+
+  const long fileOffset = fileStat.dataOffset;
+
   fseek(file, fileOffset, SEEK_SET);
 
-  const auto deflatedDataSize = static_cast<size_t>(fileStat.m_comp_size);
-  const auto inflatedDataSize = static_cast<size_t>(fileStat.m_uncomp_size);
+  const auto deflatedDataSize = static_cast<size_t>(fileStat.compressedSize);
+  const auto inflatedDataSize = static_cast<size_t>(fileStat.inflatedSize);
   const auto dataSize = trailingNullByte ? inflatedDataSize + 1 : inflatedDataSize;
   const auto data = static_cast<uint8_t*>(malloc(dataSize));
   if (data == nullptr) {
     Serial.printf("[%lu] [ZIP] Failed to allocate memory for output buffer (%zu bytes)\n", millis(), dataSize);
-    fclose(file);
     return nullptr;
   }
 
-  if (fileStat.m_method == MZ_NO_COMPRESSION) {
+  if (fileStat.method == MZ_NO_COMPRESSION) {
     // no deflation, just read content
     const size_t dataRead = fread(data, 1, inflatedDataSize, file);
-    fclose(file);
 
     if (dataRead != inflatedDataSize) {
       Serial.printf("[%lu] [ZIP] Failed to read data\n", millis());
@@ -133,17 +590,15 @@ uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const boo
     }
 
     // Continue out of block with data set
-  } else if (fileStat.m_method == MZ_DEFLATED) {
+  } else if (fileStat.method == MZ_DEFLATED) {
     // Read out deflated content from file
     const auto deflatedData = static_cast<uint8_t*>(malloc(deflatedDataSize));
     if (deflatedData == nullptr) {
       Serial.printf("[%lu] [ZIP] Failed to allocate memory for decompression buffer\n", millis());
-      fclose(file);
       return nullptr;
     }
 
     const size_t dataRead = fread(deflatedData, 1, deflatedDataSize, file);
-    fclose(file);
 
     if (dataRead != deflatedDataSize) {
       Serial.printf("[%lu] [ZIP] Failed to read data, expected %d got %d\n", millis(), deflatedDataSize, dataRead);
@@ -164,7 +619,6 @@ uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const boo
     // Continue out of block with data set
   } else {
     Serial.printf("[%lu] [ZIP] Unsupported compression method\n", millis());
-    fclose(file);
     return nullptr;
   }
 
@@ -174,32 +628,23 @@ uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const boo
 }
 
 bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t chunkSize) const {
-  mz_zip_archive_file_stat fileStat;
+  FileStat fileStat;
   if (!loadFileStat(filename, &fileStat)) {
     return false;
   }
 
-  const long fileOffset = getDataOffset(fileStat);
-  if (fileOffset < 0) {
-    return false;
-  }
+  const long fileOffset = fileStat.dataOffset;
 
-  FILE* file = fopen(filePath.c_str(), "rb");
-  if (!file) {
-    Serial.printf("[%lu] [ZIP] Failed to open file for streaming\n", millis());
-    return false;
-  }
   fseek(file, fileOffset, SEEK_SET);
 
-  const auto deflatedDataSize = static_cast<size_t>(fileStat.m_comp_size);
-  const auto inflatedDataSize = static_cast<size_t>(fileStat.m_uncomp_size);
+  const auto deflatedDataSize = static_cast<size_t>(fileStat.compressedSize);
+  const auto inflatedDataSize = static_cast<size_t>(fileStat.inflatedSize);
 
-  if (fileStat.m_method == MZ_NO_COMPRESSION) {
+  if (fileStat.method == MZ_NO_COMPRESSION) {
     // no deflation, just read content
     const auto buffer = static_cast<uint8_t*>(malloc(chunkSize));
     if (!buffer) {
       Serial.printf("[%lu] [ZIP] Failed to allocate memory for buffer\n", millis());
-      fclose(file);
       return false;
     }
 
@@ -209,7 +654,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
       if (dataRead == 0) {
         Serial.printf("[%lu] [ZIP] Could not read more bytes\n", millis());
         free(buffer);
-        fclose(file);
         return false;
       }
 
@@ -217,17 +661,15 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
       remaining -= dataRead;
     }
 
-    fclose(file);
     free(buffer);
     return true;
   }
 
-  if (fileStat.m_method == MZ_DEFLATED) {
+  if (fileStat.method == MZ_DEFLATED) {
     // Setup inflator
     const auto inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
     if (!inflator) {
       Serial.printf("[%lu] [ZIP] Failed to allocate memory for inflator\n", millis());
-      fclose(file);
       return false;
     }
     memset(inflator, 0, sizeof(tinfl_decompressor));
@@ -238,7 +680,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
     if (!fileReadBuffer) {
       Serial.printf("[%lu] [ZIP] Failed to allocate memory for zip file read buffer\n", millis());
       free(inflator);
-      fclose(file);
       return false;
     }
 
@@ -247,7 +688,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
       Serial.printf("[%lu] [ZIP] Failed to allocate memory for dictionary\n", millis());
       free(inflator);
       free(fileReadBuffer);
-      fclose(file);
       return false;
     }
     memset(outputBuffer, 0, TINFL_LZ_DICT_SIZE);
@@ -294,7 +734,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
         processedOutputBytes += outBytes;
         if (out.write(outputBuffer + outputCursor, outBytes) != outBytes) {
           Serial.printf("[%lu] [ZIP] Failed to write all output bytes to stream\n", millis());
-          fclose(file);
           free(outputBuffer);
           free(fileReadBuffer);
           free(inflator);
@@ -306,7 +745,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
 
       if (status < 0) {
         Serial.printf("[%lu] [ZIP] tinfl_decompress() failed with status %d\n", millis(), status);
-        fclose(file);
         free(outputBuffer);
         free(fileReadBuffer);
         free(inflator);
@@ -316,7 +754,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
       if (status == TINFL_STATUS_DONE) {
         Serial.printf("[%lu] [ZIP] Decompressed %d bytes into %d bytes\n", millis(), deflatedDataSize,
                       inflatedDataSize);
-        fclose(file);
         free(inflator);
         free(fileReadBuffer);
         free(outputBuffer);
@@ -326,7 +763,6 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
 
     // If we get here, EOF reached without TINFL_STATUS_DONE
     Serial.printf("[%lu] [ZIP] Unexpected EOF\n", millis());
-    fclose(file);
     free(outputBuffer);
     free(fileReadBuffer);
     free(inflator);
@@ -336,3 +772,18 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
   Serial.printf("[%lu] [ZIP] Unsupported compression method\n", millis());
   return false;
 }
+
+std::unique_ptr<ZipEntryReader> ZipFile::openFileReader(const char* filename, const size_t chunkSize) const {
+  FileStat fileStat;
+  if (!loadFileStat(filename, &fileStat)) {
+    return nullptr;
+  }
+
+  auto reader = std::unique_ptr<ZipEntryReader>(new ZipEntryReader(
+      file, fileStat.dataOffset, fileStat.compressedSize, fileStat.inflatedSize, fileStat.method, chunkSize));
+  if (!reader->setup()) {
+    return nullptr;
+  }
+
+  return reader;
+}
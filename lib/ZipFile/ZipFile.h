@@ -1,20 +1,71 @@
 #pragma once
 #include <Print.h>
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "ZipEntryReader.h"
 #include "miniz.h"
 
+// Cheap identity for an archive taken from its trailer and central directory, nothing is inflated
+struct ZipFingerprint {
+  uint32_t archiveSize = 0;
+  uint32_t centralDirectoryOffset = 0;
+  uint32_t centralDirectorySize = 0;
+  // CRC of the last KB of the archive, the end of the central directory along with the trailer
+  uint32_t trailerCrc = 0;
+  // CRC of the raw central directory, covers every entry's name, sizes and CRC
+  uint32_t centralDirectoryCrc = 0;
+  // Stored CRC of the first .opf entry in the central directory
+  uint32_t opfCrc = 0;
+};
+
 class ZipFile {
+  struct FileStat {
+    uint32_t localHeaderOffset;
+    uint32_t dataOffset;
+    uint32_t compressedSize;
+    uint32_t inflatedSize;
+    uint16_t method;
+  };
+
   std::string filePath;
+  // Where the sorted central directory index is persisted, empty to always use miniz lookups
+  std::string indexPath;
+  // Single handle to the archive, kept open for the lifetime of the ZipFile
+  mutable FILE* file = nullptr;
+  mutable long archiveSize = 0;
   mutable mz_zip_archive zipArchive = {};
-  bool loadFileStat(const char* filename, mz_zip_archive_file_stat* fileStat) const;
-  long getDataOffset(const mz_zip_archive_file_stat& fileStat) const;
+  mutable bool zipArchiveInitialised = false;
+  // The index is only open for the length of a lookup, so it doesn't hold an SD handle between them
+  mutable bool indexUsable = false;
+  mutable uint32_t indexEntryCount = 0;
+  mutable bool indexChecked = false;
+  mutable std::unordered_map<std::string, FileStat> fileStatCache;
+
+  bool openArchive() const;
+  bool initZipArchive() const;
+  bool openIndex() const;
+  bool buildIndex() const;
+  bool loadFileStatFromIndex(const char* filename, FileStat* fileStat) const;
+  bool loadFileStat(const char* filename, FileStat* fileStat) const;
 
  public:
-  explicit ZipFile(std::string filePath);
-  ~ZipFile() { mz_zip_reader_end(&zipArchive); }
+  explicit ZipFile(std::string filePath, std::string indexPath = "");
+  ~ZipFile();
+  // Must be called before the first entry lookup, the index is opened lazily
+  void setIndexPath(std::string indexPath);
+  bool getArchiveSize(size_t* size) const;
+  // Fills in the size, trailer CRC and central directory location from the end of central directory record
+  bool readTrailer(ZipFingerprint* fingerprint) const;
+  // readTrailer() plus a pass over the central directory for its CRC and the OPF entry's CRC
+  bool getFingerprint(ZipFingerprint* fingerprint) const;
   bool getInflatedFileSize(const char* filename, size_t* size) const;
+  bool getInflatedFileSizes(const std::vector<std::string>& filenames, std::vector<size_t>& sizes) const;
   uint8_t* readFileToMemory(const char* filename, size_t* size = nullptr, bool trailingNullByte = false) const;
   bool readFileToStream(const char* filename, Print& out, size_t chunkSize) const;
+  // Opens a pull based reader over a single entry, the reader must not outlive this ZipFile
+  std::unique_ptr<ZipEntryReader> openFileReader(const char* filename, size_t chunkSize) const;
 };
@@ -1,6 +1,11 @@
 #pragma once
+#include <Arduino.h>
 #include <BatteryMonitor.h>
 
-#define BAT_GPIO0 0  // Battery voltage
+#define BAT_GPIO0 0   // Battery voltage
+#define UART0_RXD 20  // Used for USB connection detection
 
 static BatteryMonitor battery(BAT_GPIO0);
+
+// UART0's RX line is held high by the USB bridge whenever a cable is plugged in
+inline bool isUsbConnected() { return digitalRead(UART0_RXD) == HIGH; }
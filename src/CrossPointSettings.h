@@ -17,6 +17,8 @@ class CrossPointSettings {
 
   // Should match with SettingsActivity text
   enum SLEEP_SCREEN_MODE { DARK = 0, LIGHT = 1, CUSTOM = 2, COVER = 3 };
+  // Should match with SettingsActivity text
+  enum CACHE_BUDGET { CACHE_128MB = 0, CACHE_512MB = 1, CACHE_2GB = 2, CACHE_UNLIMITED = 3 };
 
   // Sleep screen settings
   uint8_t sleepScreen = DARK;
@@ -24,6 +26,10 @@ class CrossPointSettings {
   uint8_t extraParagraphSpacing = 1;
   // Duration of the power button press
   uint8_t shortPwrBtn = 0;
+  // Limit on the space book caches take up on SD
+  uint8_t cacheBudget = CACHE_512MB;
+  // Count the pages of every chapter in the background while the reader is idle
+  uint8_t paginateWholeBook = 0;
 
   ~CrossPointSettings() = default;
 
@@ -31,6 +37,20 @@ class CrossPointSettings {
   static CrossPointSettings& getInstance() { return instance; }
 
   uint16_t getPowerButtonDuration() const { return shortPwrBtn ? 10 : 500; }
+  // 0 for no limit
+  uint64_t getCacheBudgetBytes() const {
+    switch (cacheBudget) {
+      case CACHE_128MB:
+        return 128ULL * 1024 * 1024;
+      case CACHE_2GB:
+        return 2048ULL * 1024 * 1024;
+      case CACHE_UNLIMITED:
+        return 0;
+      case CACHE_512MB:
+      default:
+        return 512ULL * 1024 * 1024;
+    }
+  }
 
   bool saveToFile() const;
   bool loadFromFile();
@@ -4,19 +4,32 @@
 #include <SD.h>
 #include <Serialization.h>
 
+#include <algorithm>
 #include <fstream>
 
 namespace {
-constexpr uint8_t STATE_FILE_VERSION = 1;
+constexpr uint8_t STATE_FILE_VERSION = 2;
 constexpr char STATE_FILE[] = "/sd/.crosspoint/state.bin";
 }  // namespace
 
 CrossPointState CrossPointState::instance;
 
+void CrossPointState::addRecentEpub(const std::string& path) {
+  recentEpubPaths.erase(std::remove(recentEpubPaths.begin(), recentEpubPaths.end(), path), recentEpubPaths.end());
+  recentEpubPaths.insert(recentEpubPaths.begin(), path);
+  if (recentEpubPaths.size() > MAX_RECENT_EPUBS) {
+    recentEpubPaths.resize(MAX_RECENT_EPUBS);
+  }
+}
+
 bool CrossPointState::saveToFile() const {
   std::ofstream outputFile(STATE_FILE);
   serialization::writePod(outputFile, STATE_FILE_VERSION);
   serialization::writeString(outputFile, openEpubPath);
+  serialization::writePod(outputFile, static_cast<uint8_t>(recentEpubPaths.size()));
+  for (const auto& path : recentEpubPaths) {
+    serialization::writeString(outputFile, path);
+  }
   outputFile.close();
   return true;
 }
@@ -26,7 +39,8 @@ bool CrossPointState::loadFromFile() {
 
   uint8_t version;
   serialization::readPod(inputFile, version);
-  if (version != STATE_FILE_VERSION) {
+  // Version 1 is the same without the recent books
+  if (version != STATE_FILE_VERSION && version != 1) {
     Serial.printf("[%lu] [CPS] Deserialization failed: Unknown version %u\n", millis(), version);
     inputFile.close();
     return false;
@@ -34,6 +48,22 @@ bool CrossPointState::loadFromFile() {
 
   serialization::readString(inputFile, openEpubPath);
 
+  recentEpubPaths.clear();
+  if (version >= 2) {
+    uint8_t recentCount = 0;
+    serialization::readPod(inputFile, recentCount);
+    std::string path;
+    for (uint8_t i = 0; i < recentCount && i < MAX_RECENT_EPUBS; i++) {
+      serialization::readString(inputFile, path);
+      if (!inputFile) {
+        break;
+      }
+      recentEpubPaths.push_back(path);
+    }
+  } else if (!openEpubPath.empty()) {
+    recentEpubPaths.push_back(openEpubPath);
+  }
+
   inputFile.close();
   return true;
 }
@@ -1,18 +1,26 @@
 #pragma once
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 class CrossPointState {
   // Static instance
   static CrossPointState instance;
 
  public:
+  static constexpr size_t MAX_RECENT_EPUBS = 5;
+
   std::string openEpubPath;
+  // Books opened most recently first, for indexing them ahead of time
+  std::vector<std::string> recentEpubPaths;
   ~CrossPointState() = default;
 
   // Get singleton instance
   static CrossPointState& getInstance() { return instance; }
 
+  // Moves the book to the front of the recent books, dropping the oldest beyond MAX_RECENT_EPUBS
+  void addRecentEpub(const std::string& path);
+
   bool saveToFile() const;
 
   bool loadFromFile();
@@ -4,6 +4,8 @@
 #include <InputManager.h>
 #include <SD.h>
 
+#include "Battery.h"
+#include "CrossPointState.h"
 #include "config.h"
 
 namespace {
@@ -31,11 +33,17 @@ void HomeActivity::onEnter() {
               1,                  // Priority
               &displayTaskHandle  // Task handle
   );
+
+  preIndexer.reset(new LibraryPreIndexer(renderer, renderingMutex));
+  preIndexer->start(APP_STATE.recentEpubPaths);
 }
 
 void HomeActivity::onExit() {
   Activity::onExit();
 
+  // Before taking the mutex, the pre-indexer needs it to unwind
+  preIndexer.reset();
+
   // Wait until not rendering to delete task to avoid killing mid-instruction to EPD
   xSemaphoreTake(renderingMutex, portMAX_DELAY);
   if (displayTaskHandle) {
@@ -46,7 +54,13 @@ void HomeActivity::onExit() {
   renderingMutex = nullptr;
 }
 
+bool HomeActivity::preventAutoSleep() { return isUsbConnected() && preIndexer && preIndexer->isWorking(); }
+
 void HomeActivity::loop() {
+  if (inputManager.wasAnyPressed() || inputManager.wasAnyReleased()) {
+    preIndexer->onInput();
+  }
+
   const bool prevPressed =
       inputManager.wasPressed(InputManager::BTN_UP) || inputManager.wasPressed(InputManager::BTN_LEFT);
   const bool nextPressed =
@@ -4,14 +4,18 @@
 #include <freertos/task.h>
 
 #include <functional>
+#include <memory>
 
 #include "../Activity.h"
+#include "LibraryPreIndexer.h"
 
 class HomeActivity final : public Activity {
   TaskHandle_t displayTaskHandle = nullptr;
   SemaphoreHandle_t renderingMutex = nullptr;
   int selectorIndex = 0;
   bool updateRequired = false;
+  // Builds the recent books' chapters while the home screen is left alone
+  std::unique_ptr<LibraryPreIndexer> preIndexer;
   const std::function<void()> onReaderOpen;
   const std::function<void()> onSettingsOpen;
   const std::function<void()> onFileTransferOpen;
@@ -30,4 +34,6 @@ class HomeActivity final : public Activity {
   void onEnter() override;
   void onExit() override;
   void loop() override;
+  // Pre-indexing keeps going on USB power, the night on the charger is when it gets through whole books
+  bool preventAutoSleep() override;
 };
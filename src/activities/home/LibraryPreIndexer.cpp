@@ -0,0 +1,234 @@
+#include "LibraryPreIndexer.h"
+
+#include <Epub/Section.h>
+#include <Esp.h>
+#include <SD.h>
+
+#include "Battery.h"
+#include "CrossPointSettings.h"
+#include "activities/reader/EpubReaderLayout.h"
+#include "config.h"
+
+using EpubReaderLayout::lineCompression;
+using EpubReaderLayout::marginBottom;
+using EpubReaderLayout::marginLeft;
+using EpubReaderLayout::marginRight;
+using EpubReaderLayout::marginTop;
+
+namespace {
+// How long the buttons have to be left alone before pre-indexing starts, or carries on after being interrupted
+constexpr unsigned long startIdleMs = 5000;
+// Same limits as the reader's background indexing
+constexpr uint32_t startMinFreeHeap = 80 * 1024;
+constexpr uint32_t minFreeHeap = 32 * 1024;
+// Off USB, a build keeps the CPU and SD busy for seconds at a time, so it's only worth the charge with plenty left
+constexpr uint16_t minBatteryPercentage = 50;
+// The battery is read through the ADC, no need to do that every time the task wakes up
+constexpr unsigned long powerCheckIntervalMs = 10000;
+}  // namespace
+
+void LibraryPreIndexer::taskTrampoline(void* param) {
+  auto* self = static_cast<LibraryPreIndexer*>(param);
+  self->taskLoop();
+}
+
+void LibraryPreIndexer::start(const std::vector<std::string>& recentEpubPaths) {
+  if (taskHandle || recentEpubPaths.empty()) {
+    return;
+  }
+
+  bookPaths = recentEpubPaths;
+  bookIndex = 0;
+  stopRequested = false;
+  finished = false;
+  lastInputMs = millis();
+  lastPowerCheckMs = 0;
+  powerChecked = false;
+  // Below the display task so pre-indexing only ever gets the time rendering doesn't need
+  xTaskCreate(&LibraryPreIndexer::taskTrampoline, "LibraryPreIndexerTask",
+              8192,        // Stack size
+              this,        // Parameters
+              0,           // Priority
+              &taskHandle  // Task handle
+  );
+}
+
+void LibraryPreIndexer::stop() {
+  if (!taskHandle) {
+    return;
+  }
+
+  // The task's stack holds the parser mid-build, so it unwinds and deletes itself rather than being killed
+  stopRequested = true;
+  while (taskHandle) {
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+  }
+}
+
+void LibraryPreIndexer::onInput() { lastInputMs = millis(); }
+
+void LibraryPreIndexer::taskLoop() {
+  while (!stopRequested && !finished) {
+    if (millis() - lastInputMs >= startIdleMs && hasPowerToIndex()) {
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+      if (!indexNextSection()) {
+        finished = true;
+      }
+      xSemaphoreGive(renderingMutex);
+    }
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+  }
+
+  // Closing the book closes its archive on SD
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
+  closeBook();
+  xSemaphoreGive(renderingMutex);
+
+  taskHandle = nullptr;
+  vTaskDelete(nullptr);
+}
+
+// Low battery only holds work back rather than finishing it, so plugging a cable in later carries on pre-indexing
+bool LibraryPreIndexer::hasPowerToIndex() {
+  if (powerChecked && millis() - lastPowerCheckMs < powerCheckIntervalMs) {
+    return hasPower;
+  }
+
+  const bool hadPower = !powerChecked || hasPower;
+  powerChecked = true;
+  lastPowerCheckMs = millis();
+  if (isUsbConnected()) {
+    hasPower = true;
+    return true;
+  }
+
+  const uint16_t percentage = battery.readPercentage();
+  hasPower = percentage >= minBatteryPercentage;
+  if (!hasPower && hadPower) {
+    Serial.printf("[%lu] [LPI] Battery at %u%%, waiting for USB to pre-index\n", millis(), percentage);
+  }
+  return hasPower;
+}
+
+// Called with renderingMutex held
+bool LibraryPreIndexer::openNextBook() {
+  while (bookIndex < bookPaths.size()) {
+    const std::string& path = bookPaths[bookIndex++];
+    if (!SD.exists(path.c_str())) {
+      continue;
+    }
+    if (ESP.getFreeHeap() < startMinFreeHeap) {
+      Serial.printf("[%lu] [LPI] Not enough heap to pre-index: %u\n", millis(), ESP.getFreeHeap());
+      return false;
+    }
+
+    auto book = std::shared_ptr<Epub>(new Epub(path, "/.crosspoint"));
+    book->setCacheBudget(SETTINGS.getCacheBudgetBytes());
+    // Building a book's metadata can't be interrupted, so that is left to the book being opened
+    if (!book->load(false) || book->getSpineItemsCount() == 0) {
+      Serial.printf("[%lu] [LPI] No cached metadata for %s, skipping it\n", millis(), path.c_str());
+      continue;
+    }
+    book->setupCacheDir();
+
+    // Chapters from where the book was left off are the ones needed first
+    startSpineIndex = 0;
+    File f = SD.open((book->getCachePath() + "/progress.bin").c_str());
+    if (f) {
+      uint8_t data[4];
+      if (f.read(data, 4) == 4) {
+        startSpineIndex = data[0] + (data[1] << 8);
+      }
+      f.close();
+    }
+    // Past the last spine item once the book has been finished
+    if (startSpineIndex >= book->getSpineItemsCount()) {
+      startSpineIndex = 0;
+    }
+    visitedSpineItems = 0;
+    epub = std::move(book);
+    Serial.printf("[%lu] [LPI] Pre-indexing %s from spine %d\n", millis(), path.c_str(), startSpineIndex);
+    return true;
+  }
+
+  Serial.printf("[%lu] [LPI] Recent books are indexed\n", millis());
+  return false;
+}
+
+void LibraryPreIndexer::closeBook() {
+  pagination.reset();
+  epub.reset();
+}
+
+// Called with renderingMutex held, builds or counts a single spine item. False once there's nothing more to do.
+bool LibraryPreIndexer::indexNextSection() {
+  if (!epub && !openNextBook()) {
+    return false;
+  }
+
+  const int spineCount = epub->getSpineItemsCount();
+  if (visitedSpineItems >= spineCount) {
+    Serial.printf("[%lu] [LPI] Finished pre-indexing %s\n", millis(), epub->getPath().c_str());
+    closeBook();
+    return true;
+  }
+
+  const int spineIndex = (startSpineIndex + visitedSpineItems) % spineCount;
+  // Counted chapters have been built with this layout, pagination goes with the layout's caches when they are evicted
+  if (pagination && pagination->isKnown(spineIndex)) {
+    visitedSpineItems++;
+    return true;
+  }
+
+  Section section(epub, spineIndex, renderer);
+  if (!section.loadCacheMetadata(READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+                                 SETTINGS.extraParagraphSpacing)) {
+    // Building more past this point would evict caches to make room, maybe ones of the books being pre-indexed
+    const uint64_t budget = epub->getCacheBudget();
+    if (budget > 0 && epub->getCacheUsage() >= budget / 10 * 9) {
+      Serial.printf("[%lu] [LPI] Caches are close to their budget, stopping\n", millis());
+      return false;
+    }
+    if (ESP.getFreeHeap() < startMinFreeHeap) {
+      Serial.printf("[%lu] [LPI] Not enough heap to pre-index: %u\n", millis(), ESP.getFreeHeap());
+      return false;
+    }
+
+    Serial.printf("[%lu] [LPI] Indexing spine %d\n", millis(), spineIndex);
+    const auto start = millis();
+    const unsigned long inputAt = lastInputMs;
+    bool yielded = false;
+    section.setupCacheDir();
+    const bool built = section.persistPageDataToSD(
+        READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+        SETTINGS.extraParagraphSpacing, [this, inputAt, &yielded] {
+          // Hand the mutex over between chunks so the screen can still be drawn
+          xSemaphoreGive(renderingMutex);
+          vTaskDelay(1);
+          xSemaphoreTake(renderingMutex, portMAX_DELAY);
+          yielded = stopRequested || lastInputMs != inputAt || ESP.getFreeHeap() < minFreeHeap;
+          return !yielded;
+        });
+    if (!built) {
+      // Interrupted builds are resumed from their last checkpoint once input has been left alone again
+      if (yielded) {
+        Serial.printf("[%lu] [LPI] Paused indexing spine %d\n", millis(), spineIndex);
+        return true;
+      }
+      Serial.printf("[%lu] [LPI] Could not index spine %d, skipping it\n", millis(), spineIndex);
+      visitedSpineItems++;
+      return true;
+    }
+    Serial.printf("[%lu] [LPI] Indexed spine %d in %lu ms\n", millis(), spineIndex, millis() - start);
+  }
+
+  if (!section.isPartial()) {
+    if (!pagination) {
+      pagination.reset(new BookPagination(section.getLayoutDir() + "/pages.bin", spineCount));
+      pagination->load();
+    }
+    pagination->setPageCount(spineIndex, section.pageCount);
+  }
+  visitedSpineItems++;
+  return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <Epub.h>
+#include <Epub/BookPagination.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class GfxRenderer;
+
+/**
+ * Builds the section caches of the recently opened books ahead of them being read, one chapter at a time on a task of
+ * its own, so chapters open without indexing.
+ *
+ * Books are taken most recently opened first, and each book's chapters from where it was left off to the end before
+ * the ones already read. Only books with their metadata already cached are pre-indexed. Work only starts once input
+ * has been left alone for a while and stops at the next chunk when a button is touched, a build that is cut short picks
+ * up from its last checkpoint. Nothing is started while the heap is short or the caches are close to their budget on
+ * SD, so pre-indexing never evicts anything, nor while on a battery below half charge. Page counts are recorded as
+ * chapters are built, which fills in whole book pagination along the way.
+ *
+ * SD and the display share a bus, so all work is done holding the owner's rendering mutex, handed over between chunks.
+ */
+class LibraryPreIndexer {
+  GfxRenderer& renderer;
+  SemaphoreHandle_t renderingMutex;
+  TaskHandle_t taskHandle = nullptr;
+  volatile bool stopRequested = false;
+  volatile bool finished = false;
+  volatile unsigned long lastInputMs = 0;
+  // Last check of USB and the battery, only read and written by the task
+  unsigned long lastPowerCheckMs = 0;
+  bool powerChecked = false;
+  bool hasPower = false;
+  // Snapshot of the recent books taken on start, and the position in it
+  std::vector<std::string> bookPaths;
+  size_t bookIndex = 0;
+  // Book being worked on, with the spine item it was left off at and how many of its spine items have been visited
+  std::shared_ptr<Epub> epub;
+  std::unique_ptr<BookPagination> pagination;
+  int startSpineIndex = 0;
+  int visitedSpineItems = 0;
+
+  static void taskTrampoline(void* param);
+  void taskLoop();
+  bool hasPowerToIndex();
+  bool openNextBook();
+  void closeBook();
+  bool indexNextSection();
+
+ public:
+  explicit LibraryPreIndexer(GfxRenderer& renderer, SemaphoreHandle_t renderingMutex)
+      : renderer(renderer), renderingMutex(renderingMutex) {}
+  ~LibraryPreIndexer() { stop(); }
+
+  void start(const std::vector<std::string>& recentEpubPaths);
+  // Blocks until the task has unwound, must not be called holding the rendering mutex
+  void stop();
+  // Pauses any work in progress, it resumes once input has been left alone again
+  void onInput();
+  // True until every chapter of every recent book has been built, or there's no room to build more
+  bool isWorking() const { return taskHandle && !finished; }
+};
@@ -1,24 +1,34 @@
 #include "EpubReaderActivity.h"
 
 #include <Epub/Page.h>
+#include <Esp.h>
 #include <GfxRenderer.h>
 #include <InputManager.h>
 #include <SD.h>
 
+#include <algorithm>
+#include <climits>
+
 #include "Battery.h"
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "EpubReaderChapterSelectionActivity.h"
+#include "EpubReaderLayout.h"
 #include "config.h"
 
 namespace {
 constexpr int pagesPerRefresh = 15;
 constexpr unsigned long skipChapterMs = 700;
-constexpr float lineCompression = 0.95f;
-constexpr int marginTop = 8;
-constexpr int marginRight = 10;
-constexpr int marginBottom = 22;
-constexpr int marginLeft = 10;
+using EpubReaderLayout::lineCompression;
+using EpubReaderLayout::marginBottom;
+using EpubReaderLayout::marginLeft;
+using EpubReaderLayout::marginRight;
+using EpubReaderLayout::marginTop;
+// Background indexing needs room for the inflator and parser, and gives up rather than starve the page being read
+constexpr uint32_t indexStartMinFreeHeap = 80 * 1024;
+constexpr uint32_t indexMinFreeHeap = 32 * 1024;
+// How long the buttons have to be left alone before the rest of the book is paginated
+constexpr unsigned long bookPaginationIdleMs = 3000;
 }  // namespace
 
 void EpubReaderActivity::taskTrampoline(void* param) {
@@ -26,6 +36,11 @@ void EpubReaderActivity::taskTrampoline(void* param) {
   self->displayTaskLoop();
 }
 
+void EpubReaderActivity::indexerTaskTrampoline(void* param) {
+  auto* self = static_cast<EpubReaderActivity*>(param);
+  self->indexerTaskLoop();
+}
+
 void EpubReaderActivity::onEnter() {
   ActivityWithSubactivity::onEnter();
 
@@ -36,6 +51,7 @@ void EpubReaderActivity::onEnter() {
   renderingMutex = xSemaphoreCreateMutex();
 
   epub->setupCacheDir();
+  frameCache.setSpillPath(epub->getCachePath() + "/prerender.bin");
 
   File f = SD.open((epub->getCachePath() + "/progress.bin").c_str());
   if (f) {
@@ -50,6 +66,7 @@ void EpubReaderActivity::onEnter() {
 
   // Save current epub as last opened epub
   APP_STATE.openEpubPath = epub->getPath();
+  APP_STATE.addRecentEpub(epub->getPath());
   APP_STATE.saveToFile();
 
   // Trigger first update
@@ -61,11 +78,26 @@ void EpubReaderActivity::onEnter() {
               1,                  // Priority
               &displayTaskHandle  // Task handle
   );
+
+  indexerStopRequested = false;
+  indexTargetSpineIndex = -1;
+  indexingSpineIndex = -1;
+  bookPaginationStopped = false;
+  lastInputMs = millis();
+  // Below the display task so indexing only ever gets the time rendering doesn't need
+  xTaskCreate(&EpubReaderActivity::indexerTaskTrampoline, "EpubReaderIndexerTask",
+              8192,               // Stack size
+              this,               // Parameters
+              0,                  // Priority
+              &indexerTaskHandle  // Task handle
+  );
 }
 
 void EpubReaderActivity::onExit() {
   ActivityWithSubactivity::onExit();
 
+  stopIndexer();
+
   // Wait until not rendering to delete task to avoid killing mid-instruction to EPD
   xSemaphoreTake(renderingMutex, portMAX_DELAY);
   if (displayTaskHandle) {
@@ -74,11 +106,20 @@ void EpubReaderActivity::onExit() {
   }
   vSemaphoreDelete(renderingMutex);
   renderingMutex = nullptr;
+  frameCache.clear();
+  preparedSection.reset();
+  preparedSpineIndex = -1;
   section.reset();
+  bookPagination.reset();
   epub.reset();
 }
 
 void EpubReaderActivity::loop() {
+  // Any button activity pauses whole book pagination
+  if (inputManager.wasAnyPressed() || inputManager.wasAnyReleased()) {
+    lastInputMs = millis();
+  }
+
   // Pass input responsibility to sub activity if exists
   if (subActivity) {
     subActivity->loop();
@@ -122,6 +163,8 @@ void EpubReaderActivity::loop() {
     return;
   }
 
+  readingBackwards = prevReleased;
+
   // any botton press when at end of the book goes back to the last page
   if (currentSpineIndex > 0 && currentSpineIndex >= epub->getSpineItemsCount()) {
     currentSpineIndex = epub->getSpineItemsCount() - 1;
@@ -132,48 +175,34 @@ void EpubReaderActivity::loop() {
 
   const bool skipChapter = inputManager.getHeldTime() > skipChapterMs;
 
+  // The section mustn't be deleted mid-render, and the indexer drops it if building it fails, so it is only touched
+  // holding the semaphore
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
   if (skipChapter) {
-    // We don't want to delete the section mid-render, so grab the semaphore
-    xSemaphoreTake(renderingMutex, portMAX_DELAY);
     nextPageNumber = 0;
     currentSpineIndex = nextReleased ? currentSpineIndex + 1 : currentSpineIndex - 1;
     section.reset();
-    xSemaphoreGive(renderingMutex);
-    updateRequired = true;
-    return;
-  }
-
-  // No current section, attempt to rerender the book
-  if (!section) {
-    updateRequired = true;
-    return;
-  }
-
-  if (prevReleased) {
+  } else if (section && prevReleased) {
     if (section->currentPage > 0) {
       section->currentPage--;
     } else {
-      // We don't want to delete the section mid-render, so grab the semaphore
-      xSemaphoreTake(renderingMutex, portMAX_DELAY);
       nextPageNumber = UINT16_MAX;
       currentSpineIndex--;
       section.reset();
-      xSemaphoreGive(renderingMutex);
     }
-    updateRequired = true;
-  } else {
-    if (section->currentPage < section->pageCount - 1) {
+  } else if (section) {
+    // A chapter still being indexed carries on past the pages built so far
+    if (section->currentPage < section->pageCount - 1 || section->isPartial()) {
       section->currentPage++;
     } else {
-      // We don't want to delete the section mid-render, so grab the semaphore
-      xSemaphoreTake(renderingMutex, portMAX_DELAY);
       nextPageNumber = 0;
       currentSpineIndex++;
       section.reset();
-      xSemaphoreGive(renderingMutex);
     }
-    updateRequired = true;
   }
+  xSemaphoreGive(renderingMutex);
+  // With no current section this attempts to rerender the book
+  updateRequired = true;
 }
 
 void EpubReaderActivity::displayTaskLoop() {
@@ -188,6 +217,206 @@ void EpubReaderActivity::displayTaskLoop() {
   }
 }
 
+void EpubReaderActivity::indexerTaskLoop() {
+  while (!indexerStopRequested) {
+    const int target = indexTargetSpineIndex;
+    if (target >= 0 && target != preparedSpineIndex) {
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+      indexSection(target);
+      xSemaphoreGive(renderingMutex);
+    } else if (SETTINGS.paginateWholeBook && !bookPaginationStopped && bookPagination &&
+               !bookPagination->isComplete() && millis() - lastInputMs >= bookPaginationIdleMs) {
+      xSemaphoreTake(renderingMutex, portMAX_DELAY);
+      paginateNextSpineItem();
+      xSemaphoreGive(renderingMutex);
+    }
+    vTaskDelay(50 / portTICK_PERIOD_MS);
+  }
+
+  indexerTaskHandle = nullptr;
+  vTaskDelete(nullptr);
+}
+
+// Called with renderingMutex held, leaves the section in preparedSection for renderScreen to pick up
+void EpubReaderActivity::indexSection(const int spineIndex) {
+  // Superseded while waiting for the mutex, or the reader already has it open
+  if (indexerStopRequested || indexTargetSpineIndex != spineIndex || preparedSpineIndex == spineIndex) {
+    return;
+  }
+  if (section && currentSpineIndex == spineIndex) {
+    indexTargetSpineIndex = -1;
+    return;
+  }
+
+  preparedSection.reset();
+  preparedSpineIndex = -1;
+
+  // The chapter being read is built whatever the heap, it can't be shown otherwise
+  const bool upcoming = spineIndex != currentSpineIndex;
+  const auto candidate = std::shared_ptr<Section>(new Section(epub, spineIndex, renderer));
+  if (!candidate->loadCacheMetadata(READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+                                    SETTINGS.extraParagraphSpacing)) {
+    if (upcoming && ESP.getFreeHeap() < indexStartMinFreeHeap) {
+      Serial.printf("[%lu] [ERS] Not enough heap to index spine %d in background: %u\n", millis(), spineIndex,
+                    ESP.getFreeHeap());
+      indexTargetSpineIndex = -1;
+      return;
+    }
+
+    Serial.printf("[%lu] [ERS] Indexing spine %d in background\n", millis(), spineIndex);
+    const auto start = millis();
+    // Readable while it is being built, renderScreen shows pages as soon as they are written
+    preparedSection = candidate;
+    preparedSpineIndex = spineIndex;
+    indexingSpineIndex = spineIndex;
+    candidate->setupCacheDir();
+    const bool built = candidate->persistPageDataToSD(
+        READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+        SETTINGS.extraParagraphSpacing, [this, spineIndex] {
+          // Hand the mutex over between chunks so page turns aren't held up by the build
+          xSemaphoreGive(renderingMutex);
+          vTaskDelay(1);
+          xSemaphoreTake(renderingMutex, portMAX_DELAY);
+          return !indexerStopRequested && indexTargetSpineIndex == spineIndex &&
+                 (spineIndex == currentSpineIndex || ESP.getFreeHeap() >= indexMinFreeHeap);
+        });
+    indexingSpineIndex = -1;
+
+    if (!built) {
+      Serial.printf("[%lu] [ERS] Background indexing of spine %d stopped\n", millis(), spineIndex);
+      if (indexTargetSpineIndex == spineIndex) {
+        indexTargetSpineIndex = -1;
+      }
+      if (preparedSection == candidate) {
+        preparedSection.reset();
+        preparedSpineIndex = -1;
+      }
+      // The pages the reader was shown are gone with it
+      if (section == candidate) {
+        section.reset();
+      }
+      return;
+    }
+    Serial.printf("[%lu] [ERS] Indexed spine %d in background in %lu ms\n", millis(), spineIndex, millis() - start);
+    recordPageCount(*candidate, spineIndex);
+
+    // Final page count for the status bar, and lets the next chapter be queued
+    if (section == candidate) {
+      updateRequired = true;
+    }
+    return;
+  }
+
+  preparedSection = candidate;
+  preparedSpineIndex = spineIndex;
+  recordPageCount(*candidate, spineIndex);
+}
+
+// Called with renderingMutex held, counts the pages of the first chapter that hasn't been counted yet, building its
+// section if it has to. Gives way as soon as a button is touched or the indexer is needed, the build picks up from its
+// last checkpoint next time.
+void EpubReaderActivity::paginateNextSpineItem() {
+  const int spineIndex = bookPagination->nextUnknown();
+  if (spineIndex < 0) {
+    return;
+  }
+
+  // Sections the reader already holds are complete, the indexer builds them on this same task
+  if (section && spineIndex == currentSpineIndex) {
+    recordPageCount(*section, spineIndex);
+    return;
+  }
+  if (preparedSection && spineIndex == preparedSpineIndex) {
+    recordPageCount(*preparedSection, spineIndex);
+    return;
+  }
+  if (ESP.getFreeHeap() < indexStartMinFreeHeap) {
+    return;
+  }
+
+  Section counted(epub, spineIndex, renderer);
+  if (!counted.loadCacheMetadata(READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+                                 SETTINGS.extraParagraphSpacing)) {
+    Serial.printf("[%lu] [ERS] Paginating spine %d in background\n", millis(), spineIndex);
+    const unsigned long inputAt = lastInputMs;
+    bool yielded = false;
+    const bool built = counted.persistPageDataToSD(
+        READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
+        SETTINGS.extraParagraphSpacing, [this, inputAt, &yielded] {
+          xSemaphoreGive(renderingMutex);
+          vTaskDelay(1);
+          xSemaphoreTake(renderingMutex, portMAX_DELAY);
+          yielded = indexerStopRequested || lastInputMs != inputAt || indexTargetSpineIndex >= 0 || updateRequired ||
+                    ESP.getFreeHeap() < indexMinFreeHeap;
+          return !yielded;
+        });
+    if (!built) {
+      if (!yielded) {
+        Serial.printf("[%lu] [ERS] Could not paginate spine %d, stopping whole book pagination\n", millis(),
+                      spineIndex);
+        bookPaginationStopped = true;
+      }
+      return;
+    }
+  }
+  recordPageCount(counted, spineIndex);
+}
+
+// Called with renderingMutex held
+void EpubReaderActivity::recordPageCount(const Section& counted, const int spineIndex) {
+  if (counted.isPartial()) {
+    return;
+  }
+
+  if (!bookPagination) {
+    bookPagination.reset(new BookPagination(counted.getLayoutDir() + "/pages.bin", epub->getSpineItemsCount()));
+    bookPagination->load();
+  }
+  bookPagination->setPageCount(spineIndex, counted.pageCount);
+}
+
+// Called with renderingMutex held, which is let go while the indexer starts on the current chapter
+bool EpubReaderActivity::waitForPreparedSection() {
+  const int spineIndex = currentSpineIndex;
+  xSemaphoreGive(renderingMutex);
+  while (preparedSpineIndex != spineIndex && indexTargetSpineIndex == spineIndex) {
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+  }
+  xSemaphoreTake(renderingMutex, portMAX_DELAY);
+
+  // Navigated elsewhere while waiting, the next update takes it from here
+  return currentSpineIndex == spineIndex && !section && !subActivity && preparedSpineIndex == spineIndex;
+}
+
+// Called with renderingMutex held, which is let go until the indexer has written the page. False if the section was
+// dropped in the meantime.
+bool EpubReaderActivity::waitForPage(const int page) {
+  if (!section->isPartial() || page < section->pageCount) {
+    return true;
+  }
+
+  const auto waitingFor = section;
+  renderIndexingPopup();
+  while (section == waitingFor && waitingFor->isPartial() && page >= waitingFor->pageCount) {
+    xSemaphoreGive(renderingMutex);
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    xSemaphoreTake(renderingMutex, portMAX_DELAY);
+  }
+  return section == waitingFor && !subActivity;
+}
+
+void EpubReaderActivity::stopIndexer() {
+  if (!indexerTaskHandle) {
+    return;
+  }
+
+  // The task's stack holds the parser mid-build, so it unwinds and deletes itself rather than being killed
+  indexerStopRequested = true;
+  while (indexerTaskHandle) {
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+  }
+}
+
 // TODO: Failure handling
 void EpubReaderActivity::renderScreen() {
   if (!epub) {
@@ -212,43 +441,47 @@ void EpubReaderActivity::renderScreen() {
   }
 
   if (!section) {
-    const auto filepath = epub->getSpineItem(currentSpineIndex);
-    Serial.printf("[%lu] [ERS] Loading file: %s, index: %d\n", millis(), filepath.c_str(), currentSpineIndex);
-    section = std::unique_ptr<Section>(new Section(epub, currentSpineIndex, renderer));
-    if (!section->loadCacheMetadata(READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom, marginLeft,
-                                    SETTINGS.extraParagraphSpacing)) {
-      Serial.printf("[%lu] [ERS] Cache not found, building...\n", millis());
-
-      {
-        const int textWidth = renderer.getTextWidth(READER_FONT_ID, "Indexing...");
-        constexpr int margin = 20;
-        const int x = (GfxRenderer::getScreenWidth() - textWidth - margin * 2) / 2;
-        constexpr int y = 50;
-        const int w = textWidth + margin * 2;
-        const int h = renderer.getLineHeight(READER_FONT_ID) + margin * 2;
-        renderer.fillRect(x, y, w, h, false);
-        renderer.drawText(READER_FONT_ID, x + margin, y + margin, "Indexing...");
-        renderer.drawRect(x + 5, y + 5, w - 10, h - 10);
-        renderer.displayBuffer();
-        pagesUntilFullRefresh = 0;
-      }
+    // Anything being indexed for a chapter the reader has moved away from is no longer wanted
+    if (indexTargetSpineIndex != currentSpineIndex) {
+      indexTargetSpineIndex = -1;
+    }
 
-      section->setupCacheDir();
-      if (!section->persistPageDataToSD(READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom,
-                                        marginLeft, SETTINGS.extraParagraphSpacing)) {
-        Serial.printf("[%lu] [ERS] Failed to persist page data to SD\n", millis());
+    if (preparedSection && preparedSpineIndex == currentSpineIndex) {
+      Serial.printf("[%lu] [ERS] Using section from indexer, index: %d\n", millis(), currentSpineIndex);
+      section = preparedSection;
+    } else {
+      const auto filepath = epub->getSpineItem(currentSpineIndex);
+      Serial.printf("[%lu] [ERS] Loading file: %s, index: %d\n", millis(), filepath.c_str(), currentSpineIndex);
+      section = std::shared_ptr<Section>(new Section(epub, currentSpineIndex, renderer));
+      if (!section->loadCacheMetadata(READER_FONT_ID, lineCompression, marginTop, marginRight, marginBottom,
+                                      marginLeft, SETTINGS.extraParagraphSpacing)) {
+        Serial.printf("[%lu] [ERS] Cache not found, building...\n", millis());
+        // Any pre-rendered page came from the layout being replaced
+        frameCache.clear();
+        // Built by the indexer, pages are shown as soon as they are written rather than once the chapter is done
         section.reset();
-        return;
+        indexTargetSpineIndex = currentSpineIndex;
+        if (!waitForPreparedSection()) {
+          return;
+        }
+        section = preparedSection;
+      } else {
+        Serial.printf("[%lu] [ERS] Cache found, skipping build...\n", millis());
+        recordPageCount(*section, currentSpineIndex);
       }
-    } else {
-      Serial.printf("[%lu] [ERS] Cache found, skipping build...\n", millis());
     }
 
+    // The last page is only known once the whole chapter has been built
+    if (!waitForPage(nextPageNumber == UINT16_MAX ? INT_MAX : nextPageNumber)) {
+      return;
+    }
     if (nextPageNumber == UINT16_MAX) {
       section->currentPage = section->pageCount - 1;
     } else {
       section->currentPage = nextPageNumber;
     }
+  } else if (!waitForPage(section->currentPage)) {
+    return;
   }
 
   renderer.clearScreen();
@@ -270,30 +503,98 @@ void EpubReaderActivity::renderScreen() {
   }
 
   {
-    auto p = section->loadPageFromSD();
+    const auto p = section->getCurrentPage();
     if (!p) {
+      if (section->isPartial()) {
+        // The indexer is still writing the file, leave it be and try again on the next update
+        Serial.printf("[%lu] [ERS] Failed to load page from section being built\n", millis());
+        return;
+      }
       Serial.printf("[%lu] [ERS] Failed to load page from SD - clearing section cache\n", millis());
+      frameCache.clear();
       section->clearCache();
+      if (preparedSection == section) {
+        preparedSection.reset();
+        preparedSpineIndex = -1;
+      }
       section.reset();
       return renderScreen();
     }
     const auto start = millis();
-    renderContents(std::move(p));
-    Serial.printf("[%lu] [ERS] Rendered page in %dms\n", millis(), millis() - start);
+    const bool prerendered = frameCache.contains(currentSpineIndex, section->currentPage);
+    renderContents(*p, prerendered);
+    frameCache.recordTurn(prerendered, millis() - start);
   }
 
   File f = SD.open((epub->getCachePath() + "/progress.bin").c_str(), FILE_WRITE);
-  uint8_t data[4];
-  data[0] = currentSpineIndex & 0xFF;
-  data[1] = (currentSpineIndex >> 8) & 0xFF;
-  data[2] = section->currentPage & 0xFF;
-  data[3] = (section->currentPage >> 8) & 0xFF;
-  f.write(data, 4);
-  f.close();
+  if (f) {
+    uint8_t data[4];
+    data[0] = currentSpineIndex & 0xFF;
+    data[1] = (currentSpineIndex >> 8) & 0xFF;
+    data[2] = section->currentPage & 0xFF;
+    data[3] = (section->currentPage >> 8) & 0xFF;
+    f.write(data, 4);
+    f.close();
+  } else {
+    Serial.printf("[%lu] [ERS] Failed to save progress\n", millis());
+  }
+
+  // Decode the neighbouring pages while the reader is looking at this one, so the next turn comes from RAM
+  section->prefetchPage(section->currentPage + 1);
+  section->prefetchPage(section->currentPage - 1);
+  prerenderNextPage();
+
+  // Get the chapter the reader is heading into ready while they read this one, once this one is finished
+  if (!section->isPartial()) {
+    const int upcomingSpineIndex = readingBackwards ? currentSpineIndex - 1 : currentSpineIndex + 1;
+    indexTargetSpineIndex =
+        upcomingSpineIndex >= 0 && upcomingSpineIndex < epub->getSpineItemsCount() ? upcomingSpineIndex : -1;
+  }
 }
 
-void EpubReaderActivity::renderContents(std::unique_ptr<Page> page) {
-  page->render(renderer, READER_FONT_ID);
+void EpubReaderActivity::renderIndexingPopup() {
+  const int textWidth = renderer.getTextWidth(READER_FONT_ID, "Indexing...");
+  constexpr int margin = 20;
+  const int x = (GfxRenderer::getScreenWidth() - textWidth - margin * 2) / 2;
+  constexpr int y = 50;
+  const int w = textWidth + margin * 2;
+  const int h = renderer.getLineHeight(READER_FONT_ID) + margin * 2;
+  renderer.fillRect(x, y, w, h, false);
+  renderer.drawText(READER_FONT_ID, x + margin, y + margin, "Indexing...");
+  renderer.drawRect(x + 5, y + 5, w - 10, h - 10);
+  renderer.displayBuffer();
+  pagesUntilFullRefresh = 0;
+}
+
+void EpubReaderActivity::prerenderNextPage() {
+  const int nextPage = section->currentPage + 1;
+  if (nextPage >= section->pageCount) {
+    return;
+  }
+
+  const auto page = section->getPage(nextPage);
+  if (!page) {
+    return;
+  }
+
+  // Runs while the reader looks at the current page, a button press abandons it so the turn isn't held up
+  frameCache.prerender(
+      currentSpineIndex, nextPage, renderer.hasGrayscale(READER_FONT_ID),
+      [this, &page] { page->render(renderer, READER_FONT_ID); }, [this] { return updateRequired; });
+}
+
+void EpubReaderActivity::renderContents(const PageView& page, const bool prerendered) {
+  // Fills the framebuffer with one plane of the page, decoded from the pre-rendered copy when there is one
+  const auto drawPage = [this, &page, prerendered](const GfxRenderer::RenderMode mode, const uint8_t clearColor) {
+    if (prerendered && frameCache.drawPlane(mode)) {
+      return;
+    }
+    renderer.clearScreen(clearColor);
+    renderer.setRenderMode(mode);
+    page.render(renderer, READER_FONT_ID);
+  };
+
+  drawPage(GfxRenderer::BW, 0xFF);
   renderStatusBar();
   if (pagesUntilFullRefresh <= 1) {
     renderer.displayBuffer(EInkDisplay::HALF_REFRESH);
@@ -303,21 +604,21 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page) {
     pagesUntilFullRefresh--;
   }
 
+  // Text in a font without gray levels leaves nothing to draw in gray
+  if (!renderer.hasGrayscale(READER_FONT_ID)) {
+    return;
+  }
+
   // Save bw buffer to reset buffer state after grayscale data sync
   renderer.storeBwBuffer();
 
   // grayscale rendering
-  // TODO: Only do this if font supports it
   {
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
-    page->render(renderer, READER_FONT_ID);
+    drawPage(GfxRenderer::GRAYSCALE_LSB, 0x00);
     renderer.copyGrayscaleLsbBuffers();
 
     // Render and copy to MSB buffer
-    renderer.clearScreen(0x00);
-    renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
-    page->render(renderer, READER_FONT_ID);
+    drawPage(GfxRenderer::GRAYSCALE_MSB, 0x00);
     renderer.copyGrayscaleMsbBuffers();
 
     // display grayscale part
@@ -332,13 +633,23 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page) {
 void EpubReaderActivity::renderStatusBar() const {
   constexpr auto textY = 776;
 
-  // Calculate progress in book
-  const float sectionChapterProg = static_cast<float>(section->currentPage) / section->pageCount;
-  const uint8_t bookProgress = epub->calculateProgress(currentSpineIndex, sectionChapterProg);
-
   // Right aligned text for progress counter
-  const std::string progress = std::to_string(section->currentPage + 1) + "/" + std::to_string(section->pageCount) +
-                               "  " + std::to_string(bookProgress) + "%";
+  // Pages built so far while the chapter is still being indexed
+  std::string progress = std::to_string(section->currentPage + 1) + "/" + std::to_string(section->pageCount) +
+                         (section->isPartial() ? "+" : "");
+
+  // Exact once every chapter has been counted, estimated from chapter sizes until then
+  uint8_t bookProgress;
+  if (bookPagination && bookPagination->isComplete() && bookPagination->getTotalPages() > 0) {
+    const uint32_t bookPage = bookPagination->getPageOffset(currentSpineIndex) + section->currentPage + 1;
+    const uint32_t bookPages = bookPagination->getTotalPages();
+    bookProgress = static_cast<uint8_t>(std::min<uint32_t>(bookPage * 100 / bookPages, 100));
+    progress += "  " + std::to_string(bookPage) + "/" + std::to_string(bookPages);
+  } else {
+    const float sectionChapterProg = static_cast<float>(section->currentPage) / section->pageCount;
+    bookProgress = epub->calculateProgress(currentSpineIndex, sectionChapterProg);
+  }
+  progress += "  " + std::to_string(bookProgress) + "%";
   const auto progressTextWidth = renderer.getTextWidth(SMALL_FONT_ID, progress.c_str());
   renderer.drawText(SMALL_FONT_ID, GfxRenderer::getScreenWidth() - marginRight - progressTextWidth, textY,
                     progress.c_str());
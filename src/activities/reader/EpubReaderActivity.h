@@ -1,33 +1,66 @@
 #pragma once
 #include <Epub.h>
+#include <Epub/BookPagination.h>
 #include <Epub/Section.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
 
+#include "PageFrameCache.h"
 #include "activities/ActivityWithSubactivity.h"
 
 class EpubReaderActivity final : public ActivityWithSubactivity {
   std::shared_ptr<Epub> epub;
-  std::unique_ptr<Section> section = nullptr;
+  std::shared_ptr<Section> section = nullptr;
+  PageFrameCache frameCache;
   TaskHandle_t displayTaskHandle = nullptr;
   SemaphoreHandle_t renderingMutex = nullptr;
   int currentSpineIndex = 0;
   int nextPageNumber = 0;
   int pagesUntilFullRefresh = 0;
   bool updateRequired = false;
+  bool readingBackwards = false;
+  // Sections are built by the indexer task, the one being read as well as the chapter the reader is heading into.
+  // All of it is guarded by renderingMutex except the flags the tasks poll.
+  TaskHandle_t indexerTaskHandle = nullptr;
+  // Latest section from the indexer, published as soon as its build starts so pages can be read as they are written
+  std::shared_ptr<Section> preparedSection = nullptr;
+  volatile int preparedSpineIndex = -1;
+  volatile int indexTargetSpineIndex = -1;
+  volatile int indexingSpineIndex = -1;
+  volatile bool indexerStopRequested = false;
+  // Page counts of every chapter with the current layout, for page numbers across the whole book. Created once the
+  // first section has picked its layout.
+  std::unique_ptr<BookPagination> bookPagination;
+  // Set when a chapter couldn't be counted, so the job doesn't keep retrying it this session
+  bool bookPaginationStopped = false;
+  // Whole book pagination only runs once the buttons have been left alone for a while
+  volatile unsigned long lastInputMs = 0;
   const std::function<void()> onGoBack;
 
   static void taskTrampoline(void* param);
+  static void indexerTaskTrampoline(void* param);
   [[noreturn]] void displayTaskLoop();
+  void indexerTaskLoop();
+  void indexSection(int spineIndex);
+  void paginateNextSpineItem();
+  void recordPageCount(const Section& counted, int spineIndex);
+  void stopIndexer();
+  bool waitForPreparedSection();
+  bool waitForPage(int page);
   void renderScreen();
-  void renderContents(std::unique_ptr<Page> p);
+  void renderIndexingPopup();
+  void renderContents(const PageView& page, bool prerendered);
+  void prerenderNextPage();
   void renderStatusBar() const;
 
  public:
   explicit EpubReaderActivity(GfxRenderer& renderer, InputManager& inputManager, std::unique_ptr<Epub> epub,
                               const std::function<void()>& onGoBack)
-      : ActivityWithSubactivity("EpubReader", renderer, inputManager), epub(std::move(epub)), onGoBack(onGoBack) {}
+      : ActivityWithSubactivity("EpubReader", renderer, inputManager),
+        epub(std::move(epub)),
+        frameCache(renderer),
+        onGoBack(onGoBack) {}
   void onEnter() override;
   void onExit() override;
   void loop() override;
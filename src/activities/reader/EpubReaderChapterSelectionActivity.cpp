@@ -28,8 +28,9 @@ void EpubReaderChapterSelectionActivity::onEnter() {
 
   // Trigger first update
   updateRequired = true;
+  // Rows are read from book.bin on this task, which needs the room for file I/O
   xTaskCreate(&EpubReaderChapterSelectionActivity::taskTrampoline, "EpubReaderChapterSelectionActivityTask",
-              2048,               // Stack size
+              4096,               // Stack size
               this,               // Parameters
               1,                  // Priority
               &displayTaskHandle  // Task handle
@@ -104,7 +105,7 @@ void EpubReaderChapterSelectionActivity::renderScreen() {
     if (tocIndex == -1) {
       renderer.drawText(UI_FONT_ID, 20, 60 + (i % PAGE_ITEMS) * 30, "Unnamed", i != selectorIndex);
     } else {
-      auto item = epub->getTocItem(tocIndex);
+      const auto item = epub->getTocItem(tocIndex);
       renderer.drawText(UI_FONT_ID, 20 + (item.level - 1) * 15, 60 + (i % PAGE_ITEMS) * 30, item.title.c_str(),
                         i != selectorIndex);
     }
@@ -0,0 +1,11 @@
+#pragma once
+
+// Layout the reader builds sections with. Anything building sections ahead of the reader has to use the same values,
+// the reader won't find them in the cache otherwise.
+namespace EpubReaderLayout {
+constexpr float lineCompression = 0.95f;
+constexpr int marginTop = 8;
+constexpr int marginRight = 10;
+constexpr int marginBottom = 22;
+constexpr int marginLeft = 10;
+}  // namespace EpubReaderLayout
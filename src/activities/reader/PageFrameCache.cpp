@@ -0,0 +1,160 @@
+#include "PageFrameCache.h"
+
+#include <Esp.h>
+#include <SD.h>
+
+namespace {
+// Below this the planes go to SD rather than being held in RAM
+constexpr uint32_t PLANES_IN_RAM_MIN_HEAP = 64 * 1024;
+constexpr size_t SPILL_READ_CHUNK_SIZE = 512;
+// Clear colour for each plane, in planeIndex() order
+constexpr uint8_t PLANE_CLEAR_COLORS[] = {0xFF, 0x00, 0x00};
+constexpr GfxRenderer::RenderMode PLANE_MODES[] = {GfxRenderer::BW, GfxRenderer::GRAYSCALE_LSB,
+                                                   GfxRenderer::GRAYSCALE_MSB};
+}  // namespace
+
+int PageFrameCache::planeIndex(const GfxRenderer::RenderMode mode) {
+  switch (mode) {
+    case GfxRenderer::GRAYSCALE_LSB:
+      return 1;
+    case GfxRenderer::GRAYSCALE_MSB:
+      return 2;
+    case GfxRenderer::BW:
+    default:
+      return 0;
+  }
+}
+
+bool PageFrameCache::prerender(const int spineIndex, const int page, const bool grayscale,
+                               const std::function<void()>& draw, const std::function<bool()>& cancelled) {
+  if (contains(spineIndex, page)) {
+    return true;
+  }
+  clear();
+
+  const auto start = millis();
+  // BW comes first in planeIndex() order, so leaving the gray planes out is a shorter count
+  const int count = grayscale ? PLANE_COUNT : 1;
+  if (!renderer.renderToPlanes(PLANE_MODES, PLANE_CLEAR_COLORS, count, draw, planes, cancelled)) {
+    clear();
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    planeSizes[i] = planes[i].size();
+    planes[i].shrink_to_fit();
+  }
+  planeCount = count;
+
+  if (ESP.getFreeHeap() < PLANES_IN_RAM_MIN_HEAP && !spill()) {
+    clear();
+    return false;
+  }
+
+  this->spineIndex = spineIndex;
+  this->page = page;
+  Serial.printf("[%lu] [PFC] Pre-rendered page %d in %lums (%u/%u/%u bytes%s)\n", millis(), page, millis() - start,
+                planeSizes[0], planeSizes[1], planeSizes[2], spilled ? " on SD" : "");
+  return true;
+}
+
+bool PageFrameCache::spill() {
+  if (spillPath.empty()) {
+    return false;
+  }
+
+  File file = SD.open(spillPath.c_str(), FILE_WRITE);
+  if (!file) {
+    Serial.printf("[%lu] [PFC] Failed to open %s\n", millis(), spillPath.c_str());
+    return false;
+  }
+
+  bool success = true;
+  for (auto& plane : planes) {
+    success = success && file.write(plane.data(), plane.size()) == plane.size();
+    std::vector<uint8_t>().swap(plane);
+  }
+  file.close();
+
+  spilled = success;
+  return success;
+}
+
+bool PageFrameCache::contains(const int spineIndex, const int page) const {
+  return this->page >= 0 && this->spineIndex == spineIndex && this->page == page;
+}
+
+bool PageFrameCache::drawSpilledPlane(const int index) const {
+  File file = SD.open(spillPath.c_str(), FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  uint32_t position = 0;
+  for (int i = 0; i < index; i++) {
+    position += planeSizes[i];
+  }
+  file.seek(position);
+
+  // Runs can straddle reads, so anything not consumed is carried over to the front of the next read
+  uint8_t buffer[SPILL_READ_CHUNK_SIZE];
+  size_t buffered = 0;
+  size_t remaining = planeSizes[index];
+  size_t offset = 0;
+  while (remaining > 0) {
+    const size_t toRead = std::min(remaining, SPILL_READ_CHUNK_SIZE - buffered);
+    if (file.read(buffer + buffered, toRead) != toRead) {
+      break;
+    }
+    buffered += toRead;
+    remaining -= toRead;
+
+    const size_t consumed = renderer.drawPlane(buffer, buffered, &offset);
+    memmove(buffer, buffer + consumed, buffered - consumed);
+    buffered -= consumed;
+  }
+  file.close();
+
+  return remaining == 0 && buffered == 0 && offset == GfxRenderer::getBufferSize();
+}
+
+bool PageFrameCache::drawPlane(const GfxRenderer::RenderMode mode) const {
+  if (page < 0) {
+    return false;
+  }
+
+  const int index = planeIndex(mode);
+  if (index >= planeCount) {
+    return false;
+  }
+  if (spilled) {
+    return drawSpilledPlane(index);
+  }
+
+  size_t offset = 0;
+  const size_t consumed = renderer.drawPlane(planes[index].data(), planes[index].size(), &offset);
+  return consumed == planes[index].size() && offset == GfxRenderer::getBufferSize();
+}
+
+void PageFrameCache::recordTurn(const bool hit, const unsigned long turnMs) {
+  if (hit) {
+    hits++;
+  } else {
+    misses++;
+  }
+  Serial.printf("[%lu] [PFC] Page turn in %lums (%s), pre-render hit rate %u/%u\n", millis(), turnMs,
+                hit ? "hit" : "miss", hits, hits + misses);
+}
+
+void PageFrameCache::clear() {
+  for (int i = 0; i < PLANE_COUNT; i++) {
+    std::vector<uint8_t>().swap(planes[i]);
+    planeSizes[i] = 0;
+  }
+  if (spilled) {
+    SD.remove(spillPath.c_str());
+  }
+  spilled = false;
+  planeCount = 0;
+  spineIndex = -1;
+  page = -1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <GfxRenderer.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Holds the next page pre-rendered as run length encoded BW, grayscale LSB and grayscale MSB planes, so a page turn
+ * only has to decode them into the framebuffer. The planes come out of a single pass over the page, and the gray ones
+ * are left out when nothing on the page can be gray. Planes stay in RAM unless heap is short, then they are spilled
+ * to a file in the book's cache directory.
+ */
+class PageFrameCache {
+  static constexpr int PLANE_COUNT = 3;
+
+  GfxRenderer& renderer;
+  std::string spillPath;
+  int spineIndex = -1;
+  int page = -1;
+  std::vector<uint8_t> planes[PLANE_COUNT];
+  uint32_t planeSizes[PLANE_COUNT] = {};
+  int planeCount = 0;
+  bool spilled = false;
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+
+  static int planeIndex(GfxRenderer::RenderMode mode);
+  bool spill();
+  bool drawSpilledPlane(int index) const;
+
+ public:
+  explicit PageFrameCache(GfxRenderer& renderer) : renderer(renderer) {}
+
+  void setSpillPath(std::string path) { spillPath = std::move(path); }
+  // Renders draw into the BW plane for the given page, and the gray planes too if grayscale is set. Gives up early if
+  // cancelled returns true.
+  bool prerender(int spineIndex, int page, bool grayscale, const std::function<void()>& draw,
+                 const std::function<bool()>& cancelled);
+  bool contains(int spineIndex, int page) const;
+  // Decodes one plane of the cached page into the framebuffer, false if the plane wasn't rendered
+  bool drawPlane(GfxRenderer::RenderMode mode) const;
+  // Tracks how often turns were served from the cache, logged with the turn time
+  void recordTurn(bool hit, unsigned long turnMs);
+  void clear();
+};
@@ -2,6 +2,7 @@
 
 #include <SD.h>
 
+#include "CrossPointSettings.h"
 #include "Epub.h"
 #include "EpubReaderActivity.h"
 #include "FileSelectionActivity.h"
@@ -14,6 +15,7 @@ std::unique_ptr<Epub> ReaderActivity::loadEpub(const std::string& path) {
   }
 
   auto epub = std::unique_ptr<Epub>(new Epub(path, "/.crosspoint"));
+  epub->setCacheBudget(SETTINGS.getCacheBudgetBytes());
   if (epub->load()) {
     return epub;
   }
@@ -9,12 +9,18 @@
 
 // Define the static settings list
 namespace {
-constexpr int settingsCount = 4;
+constexpr int settingsCount = 6;
 const SettingInfo settingsList[settingsCount] = {
     // Should match with SLEEP_SCREEN_MODE
     {"Sleep Screen", SettingType::ENUM, &CrossPointSettings::sleepScreen, {"Dark", "Light", "Custom", "Cover"}},
     {"Extra Paragraph Spacing", SettingType::TOGGLE, &CrossPointSettings::extraParagraphSpacing, {}},
     {"Short Power Button Click", SettingType::TOGGLE, &CrossPointSettings::shortPwrBtn, {}},
+    // Should match with CACHE_BUDGET
+    {"Cache Size Limit",
+     SettingType::ENUM,
+     &CrossPointSettings::cacheBudget,
+     {"128 MB", "512 MB", "2 GB", "Unlimited"}},
+    {"Paginate Whole Book", SettingType::TOGGLE, &CrossPointSettings::paginateWholeBook, {}},
     {"Check for updates", SettingType::ACTION, nullptr, {}},
 };
 }  // namespace
@@ -34,8 +34,6 @@
 #define EPD_RST 5    // Reset
 #define EPD_BUSY 6   // Busy
 
-#define UART0_RXD 20  // Used for USB connection detection
-
 #define SD_SPI_CS 12
 #define SD_SPI_MISO 7
 
@@ -60,6 +58,13 @@ EpdFontFamily ubuntuFontFamily(&ubuntu10Font, &ubuntuBold10Font);
 
 // Auto-sleep timeout (10 minutes of inactivity)
 constexpr unsigned long AUTO_SLEEP_TIMEOUT_MS = 10 * 60 * 1000;
+// Most files open on SD at once, every slot is allocated when the card is mounted. Books only keep their archive open
+// between reads, so the worst case is reading while a chapter is built in the background: the archive, the four files
+// a build keeps open (section, resume journal, inflate checkpoint, token stream), one short lived file for whichever
+// task holds the rendering mutex (a page, progress.bin, the cache index...) and book.bin for the chapter list. That's
+// 7, plus one to spare. The home screen's pre-indexer builds one chapter of one book at a time, so it stays within
+// the same count.
+constexpr uint8_t SD_MAX_OPEN_FILES = 8;
 // measurement of power button press duration calibration value
 unsigned long t1 = 0;
 unsigned long t2 = 0;
@@ -167,12 +172,13 @@ void setup() {
   inputManager.begin();
   // Initialize pins
   pinMode(BAT_GPIO0, INPUT);
+  pinMode(UART0_RXD, INPUT);
 
   // Initialize SPI with custom pins
   SPI.begin(EPD_SCLK, SD_SPI_MISO, EPD_MOSI, EPD_CS);
 
   // SD Card Initialization
-  if (!SD.begin(SD_SPI_CS, SPI, SPI_FQ)) {
+  if (!SD.begin(SD_SPI_CS, SPI, SPI_FQ, "/sd", SD_MAX_OPEN_FILES)) {
     Serial.printf("[%lu] [   ] SD card initialization failed\n", millis());
     exitActivity();
     enterNewActivity(new FullScreenMessageActivity(renderer, inputManager, "SD card error", BOLD));
@@ -230,6 +236,11 @@ void loop() {
     lastActivityTime = millis();  // Reset inactivity timer
   }
 
+  // Activities with background work to finish keep the device awake while it is on USB power
+  if (currentActivity && currentActivity->preventAutoSleep()) {
+    lastActivityTime = millis();
+  }
+
   if (millis() - lastActivityTime >= AUTO_SLEEP_TIMEOUT_MS) {
     Serial.printf("[%lu] [SLP] Auto-sleep triggered after %lu ms of inactivity\n", millis(), AUTO_SLEEP_TIMEOUT_MS);
     enterDeepSleep();
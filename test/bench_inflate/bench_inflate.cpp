@@ -0,0 +1,208 @@
+// Host benchmark of the table driven inflate against tinfl, build from the repository root and run on some EPUB files
+//   gcc -O2 -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1 -c lib/miniz/miniz.c -o miniz.o
+//   g++ -std=c++2a -O2 -Itest/host -Ilib/ZipFile -Ilib/miniz -o bench_inflate test/bench_inflate/bench_inflate.cpp
+//       lib/ZipFile/FastInflate.cpp miniz.o
+//   ./bench_inflate *.epub
+// Every deflated entry is inflated in one go into a buffer of its inflated size, the way readFileToMemory does, by
+// tinfl and by fastInflate. Outputs have to match byte for byte. Inflate speed is reported in MB/s of output for the
+// book's text (XHTML, CSS, OPF, NCX), its images and everything else. On a 64 bit host tinfl uses a 64 bit bit buffer
+// and unaligned loads, on the ESP32-C3 it has neither, so only device numbers decide whether ZIP_FAST_INFLATE pays off.
+// Not built into the firmware.
+#include <FastInflate.h>
+#include <HardwareSerial.h>
+#include <miniz.h>
+#include <strings.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+HostSerial Serial;
+unsigned long millis() { return 0; }
+
+namespace {
+constexpr uint32_t END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+constexpr uint32_t CENTRAL_DIRECTORY_SIGNATURE = 0x02014b50;
+constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr size_t END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+constexpr size_t CENTRAL_DIRECTORY_HEADER_SIZE = 46;
+constexpr size_t LOCAL_HEADER_SIZE = 30;
+// Small entries are inflated repeatedly until about this much output has been timed
+constexpr size_t TIMED_BYTES_PER_ENTRY = 4 * 1024 * 1024;
+
+enum Kind { TEXT, IMAGE, OTHER, KIND_COUNT };
+const char* const KIND_NAMES[KIND_COUNT] = {"text", "images", "other"};
+
+struct Entry {
+  std::string name;
+  std::string deflated;
+  size_t inflatedSize;
+};
+
+struct Totals {
+  size_t entries = 0;
+  size_t inflatedBytes = 0;
+  double tinflSeconds = 0;
+  double fastSeconds = 0;
+};
+
+uint16_t read16(const std::string& data, const size_t offset) {
+  return static_cast<uint8_t>(data[offset]) | static_cast<uint8_t>(data[offset + 1]) << 8;
+}
+
+uint32_t read32(const std::string& data, const size_t offset) {
+  return read16(data, offset) | static_cast<uint32_t>(read16(data, offset + 2)) << 16;
+}
+
+// Deflated entries of the archive, straight from the central directory so nothing is inflated on the way
+bool readEntries(const char* path, std::vector<Entry>& entries) {
+  std::ifstream file(path, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (data.size() < END_OF_CENTRAL_DIRECTORY_SIZE) {
+    printf("%s: not a zip archive\n", path);
+    return false;
+  }
+
+  size_t end = data.size() - END_OF_CENTRAL_DIRECTORY_SIZE;
+  while (read32(data, end) != END_OF_CENTRAL_DIRECTORY_SIGNATURE) {
+    if (end == 0 || data.size() - end > END_OF_CENTRAL_DIRECTORY_SIZE + UINT16_MAX) {
+      printf("%s: no end of central directory\n", path);
+      return false;
+    }
+    end--;
+  }
+
+  const uint16_t count = read16(data, end + 10);
+  size_t offset = read32(data, end + 16);
+  for (uint16_t i = 0; i < count; i++) {
+    if (offset + CENTRAL_DIRECTORY_HEADER_SIZE > data.size() || read32(data, offset) != CENTRAL_DIRECTORY_SIGNATURE) {
+      printf("%s: central directory is corrupt\n", path);
+      return false;
+    }
+    const uint16_t method = read16(data, offset + 10);
+    const uint32_t deflatedSize = read32(data, offset + 20);
+    const uint32_t inflatedSize = read32(data, offset + 24);
+    const uint16_t nameLength = read16(data, offset + 28);
+    const uint32_t localOffset = read32(data, offset + 42);
+    const std::string name = data.substr(offset + CENTRAL_DIRECTORY_HEADER_SIZE, nameLength);
+    offset += CENTRAL_DIRECTORY_HEADER_SIZE + nameLength + read16(data, offset + 30) + read16(data, offset + 32);
+
+    if (method != MZ_DEFLATED || inflatedSize == 0) {
+      continue;
+    }
+    if (localOffset + LOCAL_HEADER_SIZE > data.size() || read32(data, localOffset) != LOCAL_HEADER_SIGNATURE) {
+      printf("%s: local header of %s is corrupt\n", path, name.c_str());
+      return false;
+    }
+    const size_t dataOffset =
+        localOffset + LOCAL_HEADER_SIZE + read16(data, localOffset + 26) + read16(data, localOffset + 28);
+    if (dataOffset + deflatedSize > data.size()) {
+      printf("%s: %s is truncated\n", path, name.c_str());
+      return false;
+    }
+    entries.push_back({name, data.substr(dataOffset, deflatedSize), inflatedSize});
+  }
+  return true;
+}
+
+Kind kindOf(const std::string& name) {
+  const size_t dot = name.find_last_of('.');
+  const std::string extension = dot == std::string::npos ? "" : name.substr(dot + 1);
+  for (const char* text : {"xhtml", "html", "htm", "xml", "css", "opf", "ncx"}) {
+    if (strcasecmp(extension.c_str(), text) == 0) {
+      return TEXT;
+    }
+  }
+  for (const char* image : {"jpg", "jpeg", "png", "gif", "svg", "webp", "bmp"}) {
+    if (strcasecmp(extension.c_str(), image) == 0) {
+      return IMAGE;
+    }
+  }
+  return OTHER;
+}
+
+// Same call as inflateOneShot in ZipFile.cpp
+bool tinflInflate(const Entry& entry, uint8_t* output) {
+  static tinfl_decompressor inflator;
+  tinfl_init(&inflator);
+  size_t inBytes = entry.deflated.size();
+  size_t outBytes = entry.inflatedSize;
+  const tinfl_status status =
+      tinfl_decompress(&inflator, reinterpret_cast<const uint8_t*>(entry.deflated.data()), &inBytes, nullptr, output,
+                       &outBytes, TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+  return status == TINFL_STATUS_DONE && outBytes == entry.inflatedSize;
+}
+
+bool fastInflateEntry(const Entry& entry, uint8_t* output) {
+  return fastInflate(reinterpret_cast<const uint8_t*>(entry.deflated.data()), entry.deflated.size(), output,
+                     entry.inflatedSize);
+}
+
+template <typename Inflate>
+double timeInflate(const Entry& entry, uint8_t* output, const int runs, Inflate inflate) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < runs; run++) {
+    inflate(entry, output);
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* path, const std::vector<Entry>& entries) {
+  Totals totals[KIND_COUNT];
+  size_t rejected = 0;
+
+  for (const auto& entry : entries) {
+    std::vector<uint8_t> expected(entry.inflatedSize), actual(entry.inflatedSize);
+    if (!tinflInflate(entry, expected.data())) {
+      printf("%s: tinfl could not inflate %s, skipping it\n", path, entry.name.c_str());
+      continue;
+    }
+    // ZipFile falls back to tinfl for these, so they are counted but not timed
+    if (!fastInflateEntry(entry, actual.data())) {
+      rejected++;
+      continue;
+    }
+    if (actual != expected) {
+      printf("%s: fastInflate output of %s differs from tinfl\n", path, entry.name.c_str());
+      return;
+    }
+
+    const int runs = static_cast<int>(std::max<size_t>(1, TIMED_BYTES_PER_ENTRY / entry.inflatedSize));
+    Totals& kind = totals[kindOf(entry.name)];
+    kind.entries++;
+    kind.inflatedBytes += entry.inflatedSize * runs;
+    kind.tinflSeconds += timeInflate(entry, expected.data(), runs, tinflInflate);
+    kind.fastSeconds += timeInflate(entry, actual.data(), runs, fastInflateEntry);
+  }
+
+  printf("%s: %zu deflated entries, %zu rejected by fastInflate\n", path, entries.size(), rejected);
+  for (int i = 0; i < KIND_COUNT; i++) {
+    const Totals& kind = totals[i];
+    if (kind.entries == 0) {
+      continue;
+    }
+    const double megabytes = kind.inflatedBytes / (1024.0 * 1024.0);
+    printf("  %-6s %4zu entries: tinfl %7.1f MB/s, fastInflate %7.1f MB/s, %.2fx\n", KIND_NAMES[i], kind.entries,
+           megabytes / kind.tinflSeconds, megabytes / kind.fastSeconds, kind.tinflSeconds / kind.fastSeconds);
+  }
+}
+}  // namespace
+
+int main(const int argc, char** argv) {
+  if (argc < 2) {
+    printf("usage: %s book.epub...\n", argv[0]);
+    return 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    std::vector<Entry> entries;
+    if (!readEntries(argv[i], entries)) {
+      continue;
+    }
+    report(argv[i], entries);
+  }
+  return 0;
+}
@@ -0,0 +1,213 @@
+// Host benchmark of LZSS on section caches and book metadata, copy some section_<n>.bin and book.bin files off a card's
+// .crosspoint directory and run from the repository root
+//   g++ -std=c++2a -O2 -Ilib/Serialization test/bench_lzss/bench_lzss.cpp lib/Serialization/LzssStream.cpp -o bench_lzss
+//   ./bench_lzss section_*.bin */book.bin
+// For each section file it reports how well the pages compress one at a time and in groups of consecutive pages, and
+// how long decoding the group a page is in takes, which is what deciding whether pages are worth storing compressed
+// needs. For each book.bin it reports how well the records and string pool compress, and how long decoding the whole
+// file takes, as the chapter list reads single records from it. Not built into the firmware.
+#include <LzssStream.h>
+#include <Serialization.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr uint8_t SECTION_FILE_VERSION = 11;
+constexpr uint8_t BOOK_FILE_VERSION = 3;
+constexpr size_t SPINE_RECORD_SIZE = 16;
+constexpr size_t TOC_RECORD_SIZE = 24;
+constexpr std::streamoff PAGE_TABLE_FIELDS_OFFSET =
+    sizeof(uint8_t) + sizeof(int) + sizeof(float) + 4 * sizeof(int) + sizeof(bool);
+constexpr int DECODE_RUNS = 20;
+
+bool readPages(const char* path, std::vector<std::string>& pages) {
+  std::ifstream file(path, std::ios::binary);
+  uint8_t version = 0;
+  serialization::readPod(file, version);
+  if (!file || version != SECTION_FILE_VERSION) {
+    printf("%s: not a version %u section file\n", path, SECTION_FILE_VERSION);
+    return false;
+  }
+
+  uint32_t pageCount = 0, pageTableOffset = 0;
+  file.seekg(PAGE_TABLE_FIELDS_OFFSET);
+  serialization::readPod(file, pageCount);
+  serialization::readPod(file, pageTableOffset);
+  if (!file || pageTableOffset == 0) {
+    printf("%s: section is incomplete\n", path);
+    return false;
+  }
+
+  std::vector<uint32_t> offsets(pageCount);
+  file.seekg(pageTableOffset);
+  file.read(reinterpret_cast<char*>(offsets.data()), pageCount * sizeof(uint32_t));
+  // Pages are stored back to back, each one ends where the next starts
+  for (uint32_t i = 0; i < pageCount; i++) {
+    const uint32_t end = i + 1 < pageCount ? offsets[i + 1] : pageTableOffset;
+    std::string page(end - offsets[i], '\0');
+    file.clear();
+    file.seekg(offsets[i]);
+    file.read(&page[0], page.size());
+    if (!file) {
+      printf("%s: page %u is truncated\n", path, i);
+      return false;
+    }
+    pages.push_back(std::move(page));
+  }
+  return true;
+}
+
+// Bytes taken by the page's string table, which follows the version byte
+size_t stringTableSize(const std::string& page) {
+  std::istringstream is(page);
+  is.get();
+  uint32_t count = 0;
+  serialization::readVarint(is, count);
+  for (uint32_t i = 0; i < count; i++) {
+    is.ignore(page.size(), '\0');
+  }
+  return static_cast<size_t>(is.tellg()) - 1;
+}
+
+std::string compress(const std::string& data) {
+  std::ostringstream os;
+  serialization::LzssOutputBuffer encoder(os);
+  encoder.sputn(data.data(), data.size());
+  encoder.finish();
+  return os.str();
+}
+
+size_t decompress(const std::string& data, char* out, const size_t size) {
+  std::istringstream is(data);
+  serialization::LzssInputBuffer decoder(is);
+  return decoder.sgetn(out, size);
+}
+
+void report(const char* path, const std::vector<std::string>& pages) {
+  size_t raw = 0, strings = 0, stringsPacked = 0;
+  for (const auto& page : pages) {
+    raw += page.size();
+    const size_t tableSize = stringTableSize(page);
+    strings += tableSize;
+    stringsPacked += std::min(tableSize, compress(page.substr(1, tableSize)).size());
+  }
+  printf("%s: %zu pages, %zu bytes, %.0f bytes a page, string tables %.0f%% of it and compress %.2fx on their own\n",
+         path, pages.size(), raw, static_cast<double>(raw) / pages.size(), 100.0 * strings / raw,
+         static_cast<double>(strings) / stringsPacked);
+
+  std::vector<char> out(raw);
+  for (const size_t group : {1, 2, 4, 8, 16, 32}) {
+    if (group > pages.size() && group != 1) {
+      break;
+    }
+    size_t packed = 0;
+    double decodeUs = 0;
+    size_t groups = 0;
+    for (size_t first = 0; first < pages.size(); first += group) {
+      std::string data;
+      for (size_t i = first; i < std::min(first + group, pages.size()); i++) {
+        data += pages[i];
+      }
+      const std::string encoded = compress(data);
+      // Stored raw when compression doesn't help
+      packed += std::min(encoded.size(), data.size());
+      const auto start = std::chrono::steady_clock::now();
+      for (int run = 0; run < DECODE_RUNS; run++) {
+        if (decompress(encoded, out.data(), data.size()) != data.size()) {
+          printf("%s: group at page %zu failed to round trip\n", path, first);
+          return;
+        }
+      }
+      decodeUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+                  DECODE_RUNS;
+      groups++;
+    }
+    printf("  %2zu page groups: %.2fx, %.1f us to decode the group a page is in\n", group,
+           static_cast<double>(raw) / packed, decodeUs / groups);
+  }
+}
+bool readString(std::istream& is) {
+  uint32_t length = 0;
+  serialization::readPod(is, length);
+  is.ignore(length);
+  return static_cast<bool>(is);
+}
+
+void reportBook(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  std::istringstream is(data);
+  uint8_t version = 0;
+  uint32_t archiveSize = 0, spineCount = 0, tocCount = 0;
+  serialization::readPod(is, version);
+  serialization::readPod(is, archiveSize);
+  // Title, cover, toc.ncx and content base path
+  const bool headerRead = readString(is) && readString(is) && readString(is) && readString(is);
+  serialization::readPod(is, spineCount);
+  serialization::readPod(is, tocCount);
+  if (!headerRead || !is || version != BOOK_FILE_VERSION) {
+    printf("%s: not a version %u book metadata file\n", path, BOOK_FILE_VERSION);
+    return;
+  }
+
+  const size_t recordsStart = static_cast<size_t>(is.tellg());
+  const size_t poolStart = recordsStart + spineCount * SPINE_RECORD_SIZE + tocCount * TOC_RECORD_SIZE;
+  if (poolStart > data.size()) {
+    printf("%s: book metadata is truncated\n", path);
+    return;
+  }
+  const std::string records = data.substr(recordsStart, poolStart - recordsStart);
+  const std::string pool = data.substr(poolStart);
+  const std::string encoded = compress(data);
+
+  std::vector<char> out(data.size());
+  const auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < DECODE_RUNS; run++) {
+    if (decompress(encoded, out.data(), data.size()) != data.size()) {
+      printf("%s: failed to round trip\n", path);
+      return;
+    }
+  }
+  const double decodeUs =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / DECODE_RUNS;
+
+  printf("%s: %u spine items, %u TOC items, %zu bytes, records %zu and string pool %zu\n", path, spineCount, tocCount,
+         data.size(), records.size(), pool.size());
+  printf("  whole file %.2fx, records alone %.2fx, string pool alone %.2fx\n",
+         static_cast<double>(data.size()) / encoded.size(),
+         static_cast<double>(records.size()) / compress(records).size(),
+         static_cast<double>(pool.size()) / compress(pool).size());
+  printf("  %.1f us to decode the whole file, a lookup reads one %zu-%zu byte record and its strings\n", decodeUs,
+         SPINE_RECORD_SIZE, TOC_RECORD_SIZE);
+}
+
+bool isBookMetadata(const std::string& path) {
+  const size_t nameStart = path.find_last_of('/') + 1;
+  return path.compare(nameStart, std::string::npos, "book.bin") == 0;
+}
+}  // namespace
+
+int main(const int argc, char** argv) {
+  if (argc < 2) {
+    printf("usage: %s section_<n>.bin... book.bin...\n", argv[0]);
+    return 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (isBookMetadata(argv[i])) {
+      reportBook(argv[i]);
+      continue;
+    }
+    std::vector<std::string> pages;
+    if (!readPages(argv[i], pages) || pages.empty()) {
+      continue;
+    }
+    report(argv[i], pages);
+  }
+  return 0;
+}
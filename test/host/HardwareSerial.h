@@ -0,0 +1,12 @@
+#pragma once
+// Serial and millis() for building firmware code on the host, the program defines them
+#include <cstdio>
+
+struct HostSerial {
+  template <typename... Args>
+  void printf(const char* format, Args... args) {
+    std::fprintf(stderr, format, args...);
+  }
+};
+extern HostSerial Serial;
+unsigned long millis();
@@ -0,0 +1,8 @@
+#pragma once
+// Stands in for the firmware's renderer on the host, the round trip only needs to see what would be drawn
+#include <EpdFontFamily.h>
+
+class GfxRenderer {
+ public:
+  void drawText(int fontId, int x, int y, const char* text, bool black = true, EpdFontStyle style = REGULAR) const;
+};
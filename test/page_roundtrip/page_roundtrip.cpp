@@ -0,0 +1,122 @@
+// Host round trip of the page encoding, build with this as one command from the repository root and run it there
+//   g++ -std=c++2a -O1 -Itest/page_roundtrip/host -Itest/host -Ilib/Epub -Ilib/EpdFont -Ilib/Serialization
+//       -o page_roundtrip test/page_roundtrip/page_roundtrip.cpp lib/Epub/Epub/Page.cpp lib/Epub/Epub/StringTable.cpp
+//       lib/Epub/Epub/blocks/TextBlock.cpp
+//   ./page_roundtrip 2>/dev/null
+// Pages of generated lines are written with Page::serialize and read back with PageView::create. What the view draws
+// has to match what the original page draws word for word, with the same positions and styles, and every truncated
+// prefix of a page has to be rejected. Exits non zero on the first mismatch. Not built into the firmware.
+#include <Epub/Page.h>
+#include <GfxRenderer.h>
+#include <HardwareSerial.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+HostSerial Serial;
+unsigned long millis() { return 0; }
+
+namespace {
+constexpr int PAGE_COUNT = 200;
+constexpr int LINES_PER_PAGE = 25;
+
+std::vector<std::string> drawn;
+
+const char* const VOCABULARY[] = {"the",  "and", "of",         "a",       "to",  "in",  "was",
+                                  "he",   "that", "it",        "Darcy",   "said", "with", "her",
+                                  "café", "",    "Elizabeth", "extraordinarily-long-hyphenated-word"};
+constexpr size_t VOCABULARY_SIZE = sizeof(VOCABULARY) / sizeof(VOCABULARY[0]);
+
+Page makePage(std::mt19937& random) {
+  Page page;
+  const int lines = random() % (LINES_PER_PAGE + 1);
+  for (int line = 0; line < lines; line++) {
+    std::list<std::string> words;
+    std::list<uint16_t> xPositions;
+    std::list<EpdFontStyle> styles;
+    const int wordCount = random() % 12;
+    uint16_t x = random() % 20;
+    for (int i = 0; i < wordCount; i++) {
+      const std::string word = VOCABULARY[random() % VOCABULARY_SIZE];
+      words.push_back(word);
+      xPositions.push_back(x);
+      x += word.size() * 11 + random() % 9;
+      // Mostly regular with the odd styled run, like real text
+      styles.push_back(random() % 6 == 0 ? static_cast<EpdFontStyle>(random() % 4) : REGULAR);
+    }
+    const auto style = static_cast<TextBlock::BLOCK_STYLE>(random() % 4);
+    page.elements.push_back(std::make_shared<PageLine>(
+        std::make_shared<TextBlock>(std::move(words), std::move(xPositions), std::move(styles), style),
+        static_cast<int16_t>(static_cast<int>(random() % 40) - 20), static_cast<int16_t>(20 + line * 30)));
+  }
+  return page;
+}
+
+std::unique_ptr<PageView> createView(const std::string& bytes, const size_t size) {
+  std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+  memcpy(data.get(), bytes.data(), size);
+  return PageView::create(std::move(data), size);
+}
+}  // namespace
+
+void GfxRenderer::drawText(const int fontId, const int x, const int y, const char* text, const bool black,
+                           const EpdFontStyle style) const {
+  drawn.push_back(std::to_string(fontId) + " " + std::to_string(x) + "," + std::to_string(y) + " " + text + " " +
+                  std::to_string(black) + " " + std::to_string(style));
+}
+
+int main() {
+  std::mt19937 random(1);
+  GfxRenderer renderer;
+  size_t totalBytes = 0;
+
+  for (int i = 0; i < PAGE_COUNT; i++) {
+    const Page page = makePage(random);
+    drawn.clear();
+    page.render(renderer, 1);
+    const std::vector<std::string> expected = drawn;
+
+    std::ostringstream stream;
+    page.serialize(stream);
+    const std::string bytes = stream.str();
+    totalBytes += bytes.size();
+
+    const auto view = createView(bytes, bytes.size());
+    if (!view) {
+      printf("page %d: PageView::create rejected the page\n", i);
+      return 1;
+    }
+    drawn.clear();
+    view->render(renderer, 1);
+    for (size_t word = 0; word < std::max(drawn.size(), expected.size()); word++) {
+      const std::string got = word < drawn.size() ? drawn[word] : "nothing";
+      const std::string want = word < expected.size() ? expected[word] : "nothing";
+      if (got != want) {
+        printf("page %d, word %zu: view draws %s, the page %s\n", i, word, got.c_str(), want.c_str());
+        return 1;
+      }
+    }
+
+    for (size_t size = 0; size < bytes.size(); size++) {
+      if (createView(bytes, size)) {
+        printf("page %d: accepted a prefix of %zu of %zu bytes\n", i, size, bytes.size());
+        return 1;
+      }
+    }
+
+    std::string otherVersion = bytes;
+    otherVersion[0] = static_cast<char>(otherVersion[0] + 1);
+    if (createView(otherVersion, otherVersion.size())) {
+      printf("page %d: accepted an unknown version\n", i);
+      return 1;
+    }
+  }
+
+  printf("%d pages round trip, %zu bytes per page on average\n", PAGE_COUNT, totalBytes / PAGE_COUNT);
+  return 0;
+}